@@ -0,0 +1,62 @@
+#pragma once
+#include <physics2d/world.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace physics2d {
+	///
+	/// \brief Calls parseOption(name, value) for every "--name value" pair of the command line.
+	/// \param parseOption = returns false for an option it does not know
+	/// \return false if an option is unknown or its value is missing.
+	///
+	bool parseBenchArgs(int argc, char** argv, auto parseOption) {
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			if (!parseOption(std::string(argv[i]), argv[i + 1]))
+			{
+				return false;
+			}
+		}
+		return argc % 2 == 1;
+	}
+
+	///
+	/// \brief Reads tree, grid or sap into broadphase.
+	/// \return false for any other name, broadphase is then left as it was.
+	///
+	inline bool parseBroadphase(const char* value, BroadphaseType& broadphase) {
+		if (std::strcmp(value, "grid") == 0) broadphase = BroadphaseType::SpatialHash;
+		else if (std::strcmp(value, "sap") == 0) broadphase = BroadphaseType::SweepAndPrune;
+		else if (std::strcmp(value, "tree") == 0) broadphase = BroadphaseType::Tree;
+		else return false;
+		return true;
+	}
+
+	///
+	/// \brief Name of broadphase as parseBroadphase() reads it.
+	///
+	inline const char* getBroadphaseName(BroadphaseType broadphase) {
+		switch (broadphase)
+		{
+		case BroadphaseType::SpatialHash: return "grid";
+		case BroadphaseType::SweepAndPrune: return "sap";
+		default: return "tree";
+		}
+	}
+
+	///
+	/// \brief Reads the options every world bench takes: --steps, --dt, --threads, --seed and --broadphase.
+	/// \param settings = any settings with steps, dt, threads, seed and broadphase members
+	/// \return false if name is not one of them or the broadphase is unknown.
+	///
+	bool parseWorldBenchOption(const std::string& name, const char* value, auto& settings) {
+		if (name == "--steps") settings.steps = uint32_t(std::atoi(value));
+		else if (name == "--dt") settings.dt = float(std::atof(value));
+		else if (name == "--threads") settings.threads = uint32_t(std::atoi(value));
+		else if (name == "--seed") settings.seed = uint32_t(std::atoi(value));
+		else if (name == "--broadphase") return parseBroadphase(value, settings.broadphase);
+		else return false;
+		return true;
+	}
+}
@@ -0,0 +1,681 @@
+#include <math_utils.h>
+#include <bench_args.h>
+#include <physics2d/job_system.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Times the integrators of math_utils.h without any window.
+// Usage: integrate_bench [--states N] [--steps N] [--threads N] [--orbit-only 1]
+
+struct IntegrateSettings {
+	uint32_t states = 100000;
+	uint32_t steps = 100;
+	uint32_t threads = 0;
+	bool orbitOnly = false;
+};
+
+bool parseArgs(int argc, char** argv, IntegrateSettings& settings) {
+	return physics2d::parseBenchArgs(argc, argv, [&](const std::string& name, const char* value) {
+		if (name == "--states") settings.states = uint32_t(std::atoi(value));
+		else if (name == "--steps") settings.steps = uint32_t(std::atoi(value));
+		else if (name == "--threads") settings.threads = uint32_t(std::atoi(value));
+		else if (name == "--orbit-only") settings.orbitOnly = std::atoi(value) != 0;
+		else return false;
+		return true;
+	});
+}
+
+template<typename Function>
+double timeSeconds(Function function) {
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Particles falling with air drag, each state is (x, y, vx, vy)
+constexpr float Drag = 0.1f;
+constexpr float GravityY = -9.81f;
+
+glm::vec4 dragDerivative(const glm::vec4& state) {
+	return glm::vec4(state.z, state.w, -Drag * state.z, GravityY - Drag * state.w);
+}
+
+void printResult(const char* name, const IntegrateSettings& settings, double single, double batched, double threaded, uint32_t threads, double difference) {
+	const double stateSteps = double(settings.states) * settings.steps;
+	std::printf("rk4 %-22s one by one %6.1f M states/s, batched %6.1f M states/s (%.2fx), %u threads %6.1f M states/s (%.2fx), max difference %g\n",
+		name, stateSteps / single * 1e-6, stateSteps / batched * 1e-6, single / batched,
+		threads, stateSteps / threaded * 1e-6, single / threaded, difference);
+}
+
+// Runs integrate(states, chunks) for every step, first on this thread and then spread over the job system
+template<typename State, typename Integrate>
+void runBatched(const IntegrateSettings& settings, physics2d::JobSystem& jobs, const std::vector<State>& initial,
+	std::vector<State>& batched, std::vector<State>& threaded, double& batchTime, double& threadedTime, Integrate integrate) {
+	batched = initial;
+	batchTime = timeSeconds([&] {
+		for (uint32_t step = 0; step < settings.steps; ++step)
+		{
+			integrate(batched, integrate::batch::SerialChunks());
+		}
+	});
+	threaded = initial;
+	threadedTime = timeSeconds([&] {
+		for (uint32_t step = 0; step < settings.steps; ++step)
+		{
+			integrate(threaded, jobs);
+		}
+	});
+}
+
+// Compares integrating one state per call with the batched integrators for the same particles stored
+// as whole states and as separate component arrays, and for states of a single float
+void benchBatch(const IntegrateSettings& settings) {
+	const float dt = 1.0f / 60.0f;
+	const uint32_t n = settings.states;
+	physics2d::JobSystem jobs(settings.threads);
+	std::vector<glm::vec4> initial(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		initial[i] = glm::vec4(float(i % 100), float(i / 100), std::sin(float(i)), std::cos(float(i)));
+	}
+
+	std::vector<glm::vec4> single = initial;
+	const double singleTime = timeSeconds([&] {
+		for (uint32_t step = 0; step < settings.steps; ++step)
+		{
+			for (auto& state : single)
+			{
+				state = integrate::rungeKutta(state, dt, [](const glm::vec4& x, float) { return dragDerivative(x); });
+			}
+		}
+	});
+
+	// Whole states, the derivative shuffles components inside every state
+	integrate::batch::Workspace<glm::vec4> workspace;
+	auto deriveStates = [](std::span<const glm::vec4> x, float, std::span<glm::vec4> dx) {
+		for (size_t i = 0; i < x.size(); ++i)
+		{
+			dx[i] = dragDerivative(x[i]);
+		}
+	};
+	std::vector<glm::vec4> batched, threaded;
+	double batchTime, threadedTime;
+	runBatched(settings, jobs, initial, batched, threaded, batchTime, threadedTime, [&](std::vector<glm::vec4>& states, auto&& chunks) {
+		integrate::batch::rungeKutta(std::span<glm::vec4>(states), dt, deriveStates, workspace, chunks);
+	});
+	float difference = 0;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		const glm::vec4 error = glm::max(glm::abs(single[i] - batched[i]), glm::abs(single[i] - threaded[i]));
+		difference = std::max({ difference, error.x, error.y, error.z, error.w });
+	}
+	printResult("vec4 particles", settings, singleTime, batchTime, threadedTime, jobs.getThreadCount(), difference);
+
+	// The same particles as x, y, vx and vy arrays, every line of the derivative is a plain loop over floats
+	using Components = std::array<std::span<float>, 4>;
+	integrate::batch::Workspace<float> componentWorkspace;
+	auto deriveComponents = [](const std::array<std::span<const float>, 4>& x, float, const Components& dx) {
+		// One loop per component, the spans may overlap as far as the compiler knows and a loop
+		// writing several of them would not be vectorized
+		const size_t count = x[0].size();
+		for (size_t i = 0; i < count; ++i)
+		{
+			dx[0][i] = x[2][i];
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			dx[1][i] = x[3][i];
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			dx[2][i] = -Drag * x[2][i];
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			dx[3][i] = GravityY - Drag * x[3][i];
+		}
+	};
+	std::vector<float> initialComponents(4 * n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			initialComponents[c * n + i] = initial[i][c];
+		}
+	}
+	std::vector<float> batchedComponents, threadedComponents;
+	runBatched(settings, jobs, initialComponents, batchedComponents, threadedComponents, batchTime, threadedTime, [&](std::vector<float>& states, auto&& chunks) {
+		const Components components = { std::span<float>(&states[0], n), std::span<float>(&states[n], n),
+			std::span<float>(&states[2 * n], n), std::span<float>(&states[3 * n], n) };
+		integrate::batch::rungeKutta(components, dt, deriveComponents, componentWorkspace, chunks);
+	});
+	difference = 0;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			difference = std::max({ difference, std::abs(single[i][c] - batchedComponents[c * n + i]), std::abs(single[i][c] - threadedComponents[c * n + i]) });
+		}
+	}
+	printResult("particle components", settings, singleTime, batchTime, threadedTime, jobs.getThreadCount(), difference);
+
+	// Bodies cooling down by convection and radiation, one temperature per state
+	const float ambient = 290.0f;
+	auto cooling = [ambient](float temperature) {
+		const float squared = temperature * temperature;
+		const float ambientSquared = ambient * ambient;
+		return -0.1f * (temperature - ambient) - 1e-10f * (squared * squared - ambientSquared * ambientSquared);
+	};
+	std::vector<float> initialTemperatures(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		initialTemperatures[i] = 300.0f + float(i % 1000);
+	}
+	std::vector<float> singleTemperatures = initialTemperatures;
+	const double singleCoolingTime = timeSeconds([&] {
+		for (uint32_t step = 0; step < settings.steps; ++step)
+		{
+			for (float& temperature : singleTemperatures)
+			{
+				temperature = integrate::rungeKutta(temperature, dt, [&](float x, float) { return cooling(x); });
+			}
+		}
+	});
+	auto deriveCooling = [&](std::span<const float> x, float, std::span<float> dx) {
+		for (size_t i = 0; i < x.size(); ++i)
+		{
+			dx[i] = cooling(x[i]);
+		}
+	};
+	std::vector<float> batchedTemperatures, threadedTemperatures;
+	runBatched(settings, jobs, initialTemperatures, batchedTemperatures, threadedTemperatures, batchTime, threadedTime, [&](std::vector<float>& states, auto&& chunks) {
+		integrate::batch::rungeKutta(std::span<float>(states), dt, deriveCooling, componentWorkspace, chunks);
+	});
+	difference = 0;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		difference = std::max({ difference, std::abs(singleTemperatures[i] - batchedTemperatures[i]), std::abs(singleTemperatures[i] - threadedTemperatures[i]) });
+	}
+	printResult("float temperatures", settings, singleCoolingTime, batchTime, threadedTime, jobs.getThreadCount(), difference);
+}
+
+// Planet on an eccentric orbit around a unit mass sun, state is (x, y, vx, vy). Slow and straight far
+// from the sun and fast and curved close to it, so a fixed step is either wasted far away or too
+// long close by.
+glm::dvec4 orbitDerivative(const glm::dvec4& state) {
+	const glm::dvec2 position(state.x, state.y);
+	const double distance = glm::length(position);
+	const glm::dvec2 acceleration = -position / (distance * distance * distance);
+	return glm::dvec4(state.z, state.w, acceleration.x, acceleration.y);
+}
+
+// Compares the derivative evaluations fixed step rk4 and adaptive Dormand-Prince take to go around
+// the orbit once with the same error
+void benchAdaptive() {
+	const double eccentricity = 0.9;
+	const double period = 2.0 * 3.14159265358979323846; // Semi-major axis 1
+	const glm::dvec4 start(1.0 - eccentricity, 0.0, 0.0, std::sqrt((1.0 + eccentricity) / (1.0 - eccentricity)));
+	auto derive = [](const glm::dvec4& x, double) { return orbitDerivative(x); };
+	// After one period the planet is back where it started
+	auto error = [&](const glm::dvec4& x) { return glm::length(glm::dvec2(x) - glm::dvec2(start)); };
+
+	std::printf("orbit, eccentricity %.2f, one period\n", eccentricity);
+	for (double tolerance : { 1e-6, 1e-8, 1e-10 })
+	{
+		integrate::AdaptiveSettings<double> adaptive;
+		adaptive.absoluteTolerance = tolerance;
+		adaptive.relativeTolerance = tolerance;
+		integrate::AdaptiveStats stats;
+		glm::dvec4 end;
+		const double adaptiveTime = timeSeconds([&] { end = integrate::dormandPrince(start, period, derive, adaptive, &stats); });
+		const double adaptiveError = error(end);
+
+		// Fewest fixed rk4 steps, doubling and then bisecting, that reach the same error
+		auto fixedError = [&](uint32_t steps) {
+			glm::dvec4 x = start;
+			const double dt = period / steps;
+			for (uint32_t i = 0; i < steps; ++i)
+			{
+				x = integrate::rungeKutta(x, dt, derive);
+			}
+			return error(x);
+		};
+		uint32_t high = 64;
+		while (fixedError(high) > adaptiveError && high < (1u << 26))
+		{
+			high *= 2;
+		}
+		uint32_t low = high / 2;
+		while (high - low > std::max(1u, high / 100))
+		{
+			const uint32_t middle = low + (high - low) / 2;
+			(fixedError(middle) > adaptiveError ? low : high) = middle;
+		}
+		const double fixedTime = timeSeconds([&] { fixedError(high); });
+		const uint64_t fixedEvaluations = 4ull * high;
+
+		std::printf("  tolerance %.0e: dopri5 error %.2e, %6u evaluations (%u steps, %u rejected) %.3f ms,"
+			" rk4 %8llu evaluations (%u steps) %.3f ms for the same error, %.1fx fewer evaluations\n",
+			tolerance, adaptiveError, stats.evaluations, stats.accepted, stats.rejected, 1e3 * adaptiveTime,
+			(unsigned long long)fixedEvaluations, high, 1e3 * fixedTime, double(fixedEvaluations) / stats.evaluations);
+	}
+}
+
+// Energy of a unit mass planet around a unit mass sun and of a unit mass on a spring
+double orbitEnergy(const glm::dvec2& position, const glm::dvec2& velocity) {
+	return 0.5 * glm::dot(velocity, velocity) - 1.0 / glm::length(position);
+}
+
+constexpr double SpringStiffness = 6.0;
+
+double springEnergy(const glm::dvec2& position, const glm::dvec2& velocity) {
+	return 0.5 * glm::dot(velocity, velocity) + 0.5 * SpringStiffness * glm::dot(position, position);
+}
+
+// Largest step, in steps of 2^(1/4), with which step keeps the energy within 1% of the start for the whole duration
+template<typename Step, typename Energy>
+double largestStableStep(double duration, glm::dvec2 startPosition, glm::dvec2 startVelocity, Step step, Energy energy) {
+	const double startEnergy = energy(startPosition, startVelocity);
+	double largest = 0;
+	for (double dt = 1e-4; dt < 1.0; dt *= std::pow(2.0, 0.25))
+	{
+		glm::dvec2 position = startPosition, velocity = startVelocity;
+		glm::dvec2 acceleration(0);
+		bool stable = true;
+		for (double t = 0; t < duration && stable; t += dt)
+		{
+			step(position, velocity, acceleration, dt, t == 0);
+			stable = std::abs(energy(position, velocity) - startEnergy) <= 0.01 * std::abs(startEnergy);
+		}
+		if (!stable)
+		{
+			break;
+		}
+		largest = dt;
+	}
+	return largest;
+}
+
+// Compares how long the steps of each integrator can be before the energy of an orbit and of a
+// spring drifts, then times the batched symplectic integrators against one state per call
+void benchSymplectic(const IntegrateSettings& settings) {
+	auto orbitAcceleration = [](const glm::dvec2& x, double) { return -x / std::pow(glm::length(x), 3.0); };
+	auto springAcceleration = [](const glm::dvec2& x, double) { return -SpringStiffness * x; };
+
+	auto compare = [&](const char* name, double duration, glm::dvec2 position, glm::dvec2 velocity, auto accelerate, auto energy) {
+		auto euler = [&](glm::dvec2& x, glm::dvec2& v, glm::dvec2&, double dt, bool) {
+			const glm::dvec2 a = accelerate(x, 0.0);
+			x += dt * v;
+			v += dt * a;
+		};
+		auto semiImplicit = [&](glm::dvec2& x, glm::dvec2& v, glm::dvec2&, double dt, bool) {
+			integrate::semiImplicitEuler(x, v, dt, accelerate);
+		};
+		auto verlet = [&](glm::dvec2& x, glm::dvec2& v, glm::dvec2& a, double dt, bool first) {
+			if (first)
+			{
+				a = accelerate(x, 0.0);
+			}
+			integrate::velocityVerlet(x, v, a, dt, accelerate);
+		};
+		auto leapfrog = [&](glm::dvec2& x, glm::dvec2& v, glm::dvec2&, double dt, bool) {
+			integrate::leapfrog(x, v, dt, accelerate);
+		};
+		// Explicit euler gains energy every step, on these it drifts past 1% at every step size tried,
+		// so a step of 0 means none passed and there is nothing to compare against
+		const double semiImplicitStep = largestStableStep(duration, position, velocity, semiImplicit, energy);
+		const std::pair<const char*, double> steps[] = {
+			{ "explicit euler", largestStableStep(duration, position, velocity, euler, energy) },
+			{ "semi-implicit euler", semiImplicitStep },
+			{ "velocity verlet", largestStableStep(duration, position, velocity, verlet, energy) },
+			{ "leapfrog", largestStableStep(duration, position, velocity, leapfrog, energy) },
+		};
+		std::printf("%s, energy within 1%% for %.0f s: largest step", name, duration);
+		for (size_t i = 0; i < std::size(steps); ++i)
+		{
+			const auto& [method, step] = steps[i];
+			std::printf("%s %s ", i == 0 ? "" : ",", method);
+			if (step == 0)
+			{
+				std::printf("none");
+			}
+			else if (semiImplicitStep == 0 || step == semiImplicitStep)
+			{
+				std::printf("%.5f s", step);
+			}
+			else
+			{
+				std::printf("%.5f s (%.1fx)", step, step / semiImplicitStep);
+			}
+		}
+		std::printf("\n");
+	};
+	const double e = 0.5;
+	compare("orbit, eccentricity 0.5", 20 * 2.0 * 3.14159265358979323846, glm::dvec2(1.0 - e, 0.0), glm::dvec2(0.0, std::sqrt((1.0 + e) / (1.0 - e))),
+		orbitAcceleration, orbitEnergy);
+	compare("spring", 60.0, glm::dvec2(1.0, 0.0), glm::dvec2(0.0, 1.0), springAcceleration, springEnergy);
+
+	// Particles on springs, one state per call against the batched form
+	const float dt = 1.0f / 60.0f;
+	const uint32_t n = settings.states;
+	std::vector<glm::vec2> startPositions(n), startVelocities(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		startPositions[i] = glm::vec2(std::sin(float(i)), std::cos(float(i)));
+		startVelocities[i] = glm::vec2(float(i % 7) - 3.0f, float(i % 5) - 2.0f);
+	}
+	auto accelerate = [](const glm::vec2& x, float) { return -float(SpringStiffness) * x; };
+	std::vector<glm::vec2> positions = startPositions, velocities = startVelocities, accelerations(n);
+	const double singleTime = timeSeconds([&] {
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			accelerations[i] = accelerate(positions[i], 0.0f);
+		}
+		for (uint32_t step = 0; step < settings.steps; ++step)
+		{
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				integrate::velocityVerlet(positions[i], velocities[i], accelerations[i], dt, accelerate);
+			}
+		}
+	});
+	auto accelerateBatch = [](std::span<const glm::vec2> x, float, std::span<glm::vec2> a) {
+		for (size_t i = 0; i < x.size(); ++i)
+		{
+			a[i] = -float(SpringStiffness) * x[i];
+		}
+	};
+	std::vector<glm::vec2> batchPositions = startPositions, batchVelocities = startVelocities, batchAccelerations(n);
+	const double batchTime = timeSeconds([&] {
+		accelerateBatch(batchPositions, 0.0f, batchAccelerations);
+		for (uint32_t step = 0; step < settings.steps; ++step)
+		{
+			integrate::batch::velocityVerlet(std::span<glm::vec2>(batchPositions), std::span<glm::vec2>(batchVelocities),
+				std::span<glm::vec2>(batchAccelerations), dt, accelerateBatch);
+		}
+	});
+	float difference = 0;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		const glm::vec2 error = glm::abs(positions[i] - batchPositions[i]);
+		difference = std::max({ difference, error.x, error.y });
+	}
+	const double stateSteps = double(n) * settings.steps;
+	std::printf("velocity verlet springs   one by one %6.1f M states/s, batched %6.1f M states/s (%.2fx), max difference %g\n",
+		stateSteps / singleTime * 1e-6, stateSteps / batchTime * 1e-6, singleTime / batchTime, difference);
+}
+
+// Runs every tableau of integrate::tableau on the drag particles, against the hand written rungeKutta(),
+// and reports the error of each around one eccentric orbit
+void benchTableaus(const IntegrateSettings& settings) {
+	const float dt = 1.0f / 60.0f;
+	std::vector<glm::vec4> initial(settings.states);
+	for (uint32_t i = 0; i < settings.states; ++i)
+	{
+		initial[i] = glm::vec4(float(i % 100), float(i / 100), std::sin(float(i)), std::cos(float(i)));
+	}
+	auto derive = [](const glm::vec4& x, float) { return dragDerivative(x); };
+	auto run = [&](auto step) {
+		std::vector<glm::vec4> states = initial;
+		const double seconds = timeSeconds([&] {
+			for (uint32_t i = 0; i < settings.steps; ++i)
+			{
+				for (auto& state : states)
+				{
+					state = step(state);
+				}
+			}
+		});
+		return std::make_pair(seconds, states);
+	};
+	const auto [handTime, handStates] = run([&](const glm::vec4& x) { return integrate::rungeKutta(x, dt, derive); });
+	const double stateSteps = double(settings.states) * settings.steps;
+
+	const double e = 0.5;
+	const double period = 2.0 * 3.14159265358979323846;
+	const glm::dvec4 orbitStart(1.0 - e, 0.0, 0.0, std::sqrt((1.0 + e) / (1.0 - e)));
+	auto bench = [&](const char* name, auto tableau) {
+		using Tableau = decltype(tableau);
+		const auto [time, states] = run([&](const glm::vec4& x) { return integrate::explicitRK<Tableau>(x, dt, derive); });
+		glm::dvec4 orbit = orbitStart;
+		const uint32_t orbitSteps = 2000;
+		for (uint32_t i = 0; i < orbitSteps; ++i)
+		{
+			orbit = integrate::explicitRK<Tableau>(orbit, period / orbitSteps, [](const glm::dvec4& x, double) { return orbitDerivative(x); });
+		}
+		std::printf("explicitRK %-16s %6.1f M states/s (%.2fx hand written rk4), orbit error with %u steps %.2e",
+			name, stateSteps / time * 1e-6, handTime / time, orbitSteps, glm::length(glm::dvec2(orbit) - glm::dvec2(orbitStart)));
+		// The other methods differ from rk4 by their truncation error, only the rk4 tableau has to match it
+		if constexpr (std::is_same_v<Tableau, integrate::tableau::RungeKutta4>)
+		{
+			float difference = 0;
+			for (size_t i = 0; i < states.size(); ++i)
+			{
+				const glm::vec4 error = glm::abs(states[i] - handStates[i]);
+				difference = std::max({ difference, error.x, error.y, error.z, error.w });
+			}
+			std::printf(", differs from hand written rk4 by %g", difference);
+		}
+		std::printf("\n");
+	};
+	std::printf("rungeKutta (hand written) %6.1f M states/s\n", stateSteps / handTime * 1e-6);
+	bench("Euler", integrate::tableau::Euler());
+	bench("MidPoint", integrate::tableau::MidPoint());
+	bench("Heun", integrate::tableau::Heun());
+	bench("RungeKutta4", integrate::tableau::RungeKutta4());
+	bench("RungeKutta38", integrate::tableau::RungeKutta38());
+	bench("SspRungeKutta3", integrate::tableau::SspRungeKutta3());
+}
+
+// Times y = x + s * y over a few thousand values of type T, written with math::add and math::mul
+// and by hand, to check that the generic math costs nothing
+template<typename T, typename Hand>
+void benchOperation(const char* name, const IntegrateSettings& settings, Hand hand) {
+	using Scalar = typename math::ScalarLayout<T>::Scalar;
+	constexpr size_t Count = math::ScalarLayout<T>::Count;
+	const size_t n = 4096;
+	std::vector<T> x(n), handY(n), mathY(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		for (size_t j = 0; j < Count; ++j)
+		{
+			reinterpret_cast<Scalar*>(&x[i])[j] = Scalar((i + j) % 17);
+			reinterpret_cast<Scalar*>(&handY[i])[j] = Scalar(j);
+		}
+	}
+	mathY = handY;
+	const Scalar s = Scalar(0.999);
+	const uint32_t repeats = std::max(1u, settings.steps * 4);
+	auto runHand = [&] {
+		for (uint32_t repeat = 0; repeat < repeats; ++repeat)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				handY[i] = hand(x[i], s, handY[i]);
+			}
+		}
+	};
+	auto runMath = [&] {
+		for (uint32_t repeat = 0; repeat < repeats; ++repeat)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				mathY[i] = math::add(x[i], math::mul(s, mathY[i]));
+			}
+		}
+	};
+	// Best of a few alternating runs, the first ones also warm up the caches
+	double handTime = 1e30, mathTime = 1e30;
+	for (int run = 0; run < 5; ++run)
+	{
+		handTime = std::min(handTime, timeSeconds(runHand));
+		mathTime = std::min(mathTime, timeSeconds(runMath));
+	}
+	const double difference = std::abs(double(reinterpret_cast<const Scalar*>(&handY[n - 1])[Count - 1] - reinterpret_cast<const Scalar*>(&mathY[n - 1])[Count - 1]));
+	const double operations = double(n) * repeats;
+	std::printf("x + s * y %-22s by hand %6.2f ns, math::add/mul %6.2f ns (%.2fx), difference %g\n",
+		name, handTime / operations * 1e9, mathTime / operations * 1e9, handTime / mathTime, difference);
+}
+
+void benchVectorMath(const IntegrateSettings& settings) {
+	auto glmHand = [](const auto& x, auto s, const auto& y) { return x + s * y; };
+	benchOperation<glm::vec2>("glm::vec2", settings, glmHand);
+	benchOperation<glm::vec3>("glm::vec3", settings, glmHand);
+	benchOperation<glm::vec4>("glm::vec4", settings, glmHand);
+	benchOperation<glm::dvec2>("glm::dvec2", settings, glmHand);
+	benchOperation<glm::dvec4>("glm::dvec4", settings, glmHand);
+	benchOperation<glm::mat3>("glm::mat3", settings, glmHand);
+	benchOperation<glm::mat4>("glm::mat4", settings, glmHand);
+	benchOperation<glm::dmat4>("glm::dmat4", settings, glmHand);
+	benchOperation<std::array<float, 8>>("std::array<float, 8>", settings, [](const std::array<float, 8>& x, float s, const std::array<float, 8>& y) {
+		std::array<float, 8> result;
+		for (size_t i = 0; i < 8; ++i)
+		{
+			result[i] = x[i] + s * y[i];
+		}
+		return result;
+	});
+	benchOperation<std::array<double, 6>>("std::array<double, 6>", settings, [](const std::array<double, 6>& x, double s, const std::array<double, 6>& y) {
+		std::array<double, 6> result;
+		for (size_t i = 0; i < 6; ++i)
+		{
+			result[i] = x[i] + s * y[i];
+		}
+		return result;
+	});
+}
+
+// Runs stiff problems at 60 fps, implicitly with one step per frame and explicitly with as many
+// substeps per frame as it takes to stay stable
+void benchImplicit(const IntegrateSettings& settings) {
+	const double frame = 1.0 / 60.0;
+	const uint32_t frames = 600;
+
+	// Damped spring with a mass of 1, state is (position, velocity)
+	for (double stiffness : { 1e2, 1e4, 1e6, 1e8 })
+	{
+		const double damping = 1.0;
+		auto derive = [&](const glm::dvec2& x, double) { return glm::dvec2(x.y, -stiffness * x.x - damping * x.y); };
+		auto accelerate = [&](double x, double) { return -stiffness * x; };
+
+		// Fewest velocity verlet substeps, in powers of two, that never swing further than the start
+		uint32_t substeps = 1;
+		for (; substeps < (1u << 16); substeps *= 2)
+		{
+			double x = 1.0, v = 0.0, a = accelerate(x, 0.0);
+			const double dt = frame / substeps;
+			bool stable = true;
+			for (uint32_t i = 0; i < frames * substeps && stable; ++i)
+			{
+				integrate::velocityVerlet(x, v, a, dt, accelerate);
+				v *= std::exp(-damping * dt);
+				stable = std::abs(x) <= 1.0 + 1e-6;
+			}
+			if (stable)
+			{
+				break;
+			}
+		}
+
+		uint32_t backwardEvaluations = 0, trapezoidalEvaluations = 0;
+		glm::dvec2 backward(1.0, 0.0), trapezoidal(1.0, 0.0);
+		double maxTrapezoidal = 0;
+		for (uint32_t i = 0; i < frames; ++i)
+		{
+			integrate::ImplicitStats stats;
+			backward = integrate::backwardEuler(backward, frame, derive, integrate::FiniteDifferenceJacobian(), {}, &stats);
+			backwardEvaluations += stats.evaluations;
+			trapezoidal = integrate::trapezoidal(trapezoidal, frame, derive, integrate::FiniteDifferenceJacobian(), {}, &stats);
+			trapezoidalEvaluations += stats.evaluations;
+			maxTrapezoidal = std::max(maxTrapezoidal, std::abs(trapezoidal.x));
+		}
+		std::printf("spring k %.0e, %u frames: velocity verlet needs %5u substeps per frame (%8u evaluations),"
+			" backward euler 1 step (%u evaluations, position after %.2e), trapezoidal 1 step (%u evaluations, largest swing %.2f)\n",
+			stiffness, frames, substeps, substeps * frames, backwardEvaluations, std::abs(backward.x), trapezoidalEvaluations, maxTrapezoidal);
+	}
+
+	// Heat spreading along a rod of n cells, explicit euler is only stable below dt = h^2 / (2 * diffusivity)
+	const size_t n = std::min<size_t>(settings.states, 10000);
+	const double h = 1.0 / double(n);
+	const double diffusivity = 1e-3;
+	auto laplacian = [&](const std::vector<double>& x, double, std::vector<double>& dx) {
+		const double scale = diffusivity / (h * h);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double left = i > 0 ? x[i - 1] : 0.0;
+			const double right = i + 1 < n ? x[i + 1] : 0.0;
+			dx[i] = scale * (left - 2.0 * x[i] + right);
+		}
+	};
+	std::vector<double> start(n, 0.0);
+	for (size_t i = n / 4; i < n / 2; ++i)
+	{
+		start[i] = 1.0;
+	}
+	const uint32_t heatFrames = 5;
+	const uint32_t substeps = uint32_t(std::ceil(frame / (0.9 * h * h / (2.0 * diffusivity))));
+	std::vector<double> explicitState = start, dx(n);
+	const double explicitTime = timeSeconds([&] {
+		const double dt = frame / substeps;
+		for (uint32_t i = 0; i < heatFrames * substeps; ++i)
+		{
+			laplacian(explicitState, 0.0, dx);
+			for (size_t j = 0; j < n; ++j)
+			{
+				explicitState[j] += dt * dx[j];
+			}
+		}
+	});
+
+	std::vector<double> implicitState = start;
+	integrate::ImplicitWorkspace<std::vector<double>> workspace;
+	uint32_t newtonIterations = 0, linearIterations = 0;
+	const double implicitTime = timeSeconds([&] {
+		for (uint32_t i = 0; i < heatFrames; ++i)
+		{
+			integrate::ImplicitStats stats;
+			integrate::backwardEuler(implicitState, frame, laplacian, workspace,
+				[&](const std::vector<double>&, double t, const std::vector<double>& v, std::vector<double>& out) { laplacian(v, t, out); },
+				{}, &stats);
+			newtonIterations += stats.iterations;
+			linearIterations += stats.linearIterations;
+		}
+	});
+	double difference = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		difference = std::max(difference, std::abs(explicitState[i] - implicitState[i]));
+	}
+	std::printf("heat rod of %zu cells, %u frames: explicit euler %u substeps per frame %.1f ms per frame,"
+		" backward euler with conjugate gradients %.1f ms per frame (%.1f newton, %.0f cg iterations per frame), max difference %.2e\n",
+		n, heatFrames, substeps, 1e3 * explicitTime / heatFrames, 1e3 * implicitTime / heatFrames,
+		double(newtonIterations) / heatFrames, double(linearIterations) / heatFrames, difference);
+}
+
+int main(int argc, char** argv) {
+	IntegrateSettings settings;
+	if (!parseArgs(argc, argv, settings))
+	{
+		std::printf("Usage: %s [--states N] [--steps N] [--threads N] [--orbit-only 1]\n", argv[0]);
+		return 1;
+	}
+	if (!settings.orbitOnly)
+	{
+		benchBatch(settings);
+		benchSymplectic(settings);
+		benchTableaus(settings);
+		benchVectorMath(settings);
+		benchImplicit(settings);
+	}
+	benchAdaptive();
+	return 0;
+}
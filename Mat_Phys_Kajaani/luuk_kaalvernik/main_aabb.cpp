@@ -1,149 +1,32 @@
 #include <mikroplot/window.h>
 #include <glm/glm.hpp>
-#include <glm/gtx/transform.hpp>
+#include <physics2d/world.h>
+#include <physics2d/fixed_timestep.h>
+#include <profiler_overlay.h>
 
-struct Box
-{
-	glm::vec2 position;
-	glm::vec2 halfsize;
-	float rotation = 0.0f;
-	bool isColliding = false;
-	bool isStatic = false;
-	glm::vec2 velocity = glm::vec2(0);
-	glm::vec2 oldPosition;
-};
-
-struct Sphere {
-	glm::vec2 position;
-	float radius = 0.5f;
-	bool isColliding = false;
-	bool isStatic = false;
-	glm::vec2 velocity = glm::vec2(0);
-	glm::vec2 oldPosition;
-};
-
-bool isAABBCollision(const Box& a, const Box& b, glm::vec2& normalVec) {
-	glm::vec2 d = b.position - a.position;
-	glm::vec2 hs = b.halfsize + a.halfsize;
-	bool x = std::abs(d.x) < hs.x;
-	bool y = std::abs(d.y) < hs.y;
-
-	if (x && y)
-	{
-		float overlapX = hs.x - std::abs(d.x);
-		float overlapY = hs.y - std::abs(d.y);
-		// normalVec = glm::normalize(-d);
-		if (overlapX > overlapY)
-		{
-			normalVec.y = overlapY;
-			normalVec.x = 0;
-			normalVec = glm::normalize(normalVec);
-		} else
-		{
-			normalVec.y = 0;
-			normalVec.x = overlapX;
-			normalVec = glm::normalize(normalVec);
-		}
-		return true;
-	}
-
-	return false;
-}
-
-bool isSphereSphereCollision(const Sphere& a, const Sphere& b, glm::vec2& normalVec) {
-	float d = glm::length(b.position - a.position);
-	float rTot = b.radius + a.radius;
-
-	if (d < rTot) {
-		normalVec = glm::normalize(a.position - b.position);
-
-		return true;
-	}
-
-	return false;
-
-}
-
-
-std::vector<glm::vec2> getVertices(const Box& box, float scale) {
-	std::vector<glm::vec2> vertices;
-
-	vertices.push_back(glm::vec2(-box.halfsize.x, box.halfsize.y)); // Top left
-	vertices.push_back(glm::vec2(-box.halfsize.x, -box.halfsize.y)); // Bottem left
-	vertices.push_back(glm::vec2(box.halfsize.x, -box.halfsize.y)); // Bottem right
-	vertices.push_back(glm::vec2(box.halfsize.x, box.halfsize.y)); // Top right
-	// Top left (again because we want to close "line loop")
-	vertices.push_back(glm::vec2(-box.halfsize.x, box.halfsize.y));
-
-	// Transform vertices using matrices
-	glm::mat4 matTranslation = glm::translate(glm::vec3(box.position /*x,y*/, 0.0f /*z == 0*/));
-	glm::mat4 matScale = glm::scale(glm::vec3(scale, scale, scale));
-	glm::mat4 matRotation = glm::rotate(box.rotation, glm::vec3(0, 0, 1));
-
-	glm::mat4 mathModel = matTranslation * matRotation * matScale;
-	// matModel is the model matrix for our object.
-	for (auto& vert : vertices)
-	{
-		// M *<vert.x, vert.y, 0, 1>
-		vert = mathModel * glm::vec4(vert, 0, 1);
-	}
-
-	// glm::mat4 MVP = matProjction * glm::inverse(matview) * matModel,
-
-	return vertices;
-}
-
-bool isSphereAABBCollision(const Sphere& sphere, const Box& b, glm::vec2& normalVec) {
-	auto verts = getVertices(b, 1.0f); // Get vertices with scale of one
-	for (const auto vertex : verts) {
-
-		auto d = glm::length(vertex - sphere.position);
-
-		if (d < sphere.radius)
-		{
-			normalVec = glm::normalize(sphere.position - b.position);
-
-			return true;
-		}
-	}
-
-	return false;
-}
-
-void simulate(auto& objects, float deltaTime) {
-	for (auto& obj : objects){
-		obj.oldPosition = obj.position;
-		if (obj.isStatic)
-		{
-			continue;
-		}
-		auto oldPosition = obj.position;
-		glm::vec2 gravity(0, -9.81f);
-		
-		obj.velocity += gravity * deltaTime;
-		obj.position += obj.velocity * deltaTime;
-	}
-}
-
-void reactCollision(auto& a, auto& b, const glm::vec2& normalVec) {
-	a.velocity = 0.9f * glm::reflect(a.velocity, normalVec);
-	b.velocity = 0.9f * glm::reflect(b.velocity, -normalVec);
-}
+using physics2d::Box;
+using physics2d::Sphere;
 
 int main() {
 	mikroplot::Window window(900, 900, "AABB Points");
 	
-	std::vector<Sphere> spheres;
-	std::vector<Box> boxes;
+	// All broadphases find the same pairs, pick the one that suits the scene:
+	// SpatialHash for many similar sized bodies, SweepAndPrune for slow movers and
+	// Tree for big static walls mixed with small moving bodies.
+	physics2d::WorldSettings settings;
+	settings.broadphase = physics2d::BroadphaseType::Tree;
+	physics2d::World world(settings);
+	std::vector<Sphere>& spheres = world.spheres;
+	std::vector<Box>& boxes = world.boxes;
 
 	// static ground
-	boxes.push_back({ {0, -9.0f}, {9.0f, 0.5f} });
+	boxes.push_back({ .position = {0, -9.0f}, .halfsize = {9.0f, 0.5f} });
 	boxes.back().isStatic = true;
-	boxes.push_back({ {-9.0, 0.0f}, {0.5f, 7.5f} });
+	boxes.push_back({ .position = {-9.0, 0.0f}, .halfsize = {0.5f, 7.5f} });
 	boxes.back().isStatic = true;
-	boxes.push_back({ {9.0, 0.0f}, {0.5f, 7.5f} });
+	boxes.push_back({ .position = {9.0, 0.0f}, .halfsize = {0.5f, 7.5f} });
 	boxes.back().isStatic = true;
-	boxes.push_back({ {0, 9.0f}, {9.0f, 0.5f} });
+	boxes.push_back({ .position = {0, 9.0f}, .halfsize = {9.0f, 0.5f} });
 
 	boxes.back().isStatic = true;
 
@@ -165,87 +48,60 @@ int main() {
 
 	boxes.push_back(box2);
 
-	spheres.push_back({ Sphere { {-2.0f, 1.0f}, 1.0f } });
-	spheres.push_back({ Sphere { {1.0f, -1.0f}, 0.5f } });
+	spheres.push_back({ Sphere { .position = {-2.0f, 1.0f}, .radius = 1.0f } });
+	spheres.push_back({ Sphere { .position = {1.0f, -1.0f}, .radius = 0.5f } });
+
+	// Reused for drawing every box, so it does not allocate each frame
+	std::vector<mikroplot::vec2> points;
 
+	// Nothing to interpolate from before the first step
+	for (auto& box : boxes)
+	{
+		box.oldPosition = box.position;
+	}
+	for (auto& sphere : spheres)
+	{
+		sphere.oldPosition = sphere.position;
+	}
+
+	// Physics runs at a fixed 60 Hz no matter how fast the window renders.
+	// Continuous collision keeps fast boxes out of the thin walls, so no smaller steps are needed.
+	physics2d::FixedTimestep fixedStep(60.0f);
 	mikroplot::Timer timer;
 	float totalTime = 0;
+
+	// O starts the profiler and shows the frame time of each zone as stacked bars,
+	// P writes the last frames to profile.csv and profile.json
+	physics2d::Profiler& profiler = physics2d::Profiler::get();
+	bool showProfiler = false;
 	while (window.shouldClose() == false)
 	{
-		float deltaTime = timer.getDeltaTime();
-		if (deltaTime > 0.1f)
-		{
-			deltaTime = 0.1f;
-		}
-		totalTime += deltaTime;
-
 		// Move box[0]:
 		float moveX = window.getKeyState(mikroplot::KEY_RIGHT) - window.getKeyState(mikroplot::KEY_LEFT);
 		float moveY = window.getKeyState(mikroplot::KEY_UP) - window.getKeyState(mikroplot::KEY_DOWN);
-		spheres[0].position += glm::vec2(moveX, moveY) * deltaTime;
-
-		simulate(boxes, deltaTime);
-		simulate(spheres, deltaTime);
 
-		// Reset collision flags from previous frame
-		for (size_t i = 0; i < boxes.size(); ++i)
+		if (window.getKeyPressed(mikroplot::KEY_O))
 		{
-			boxes[i].isColliding = false;
+			showProfiler = !showProfiler;
+			profiler.setEnabled(showProfiler);
 		}
-
-		for (size_t i = 0; i < spheres.size(); ++i)
+		if (window.getKeyPressed(mikroplot::KEY_P))
 		{
-			spheres[i].isColliding = false;
+			physics2d::dumpProfiler(profiler);
 		}
 
-		// Check collisions between each object:
-		for (size_t ia = 0; ia < boxes.size(); ++ia)
-		{
-			for (size_t ib = ia + 1; ib < boxes.size(); ++ib)
-			{
-				glm::vec2 normal;
-				if (isAABBCollision(boxes[ia], boxes[ib], normal))
-				{
-					boxes[ia].isColliding = true;
-					boxes[ib].isColliding = true;
-					boxes[ia].position = boxes[ia].oldPosition;
-					boxes[ib].position = boxes[ib].oldPosition;
-					reactCollision(boxes[ia], boxes[ib], normal);
-				}
-			}
-		}
-		
-		for (size_t ia = 0; ia < spheres.size(); ++ia)
-		{
-			for (size_t ib = ia + 1; ib < spheres.size(); ++ib)
+		fixedStep.advance(timer.getDeltaTime(), [&](float deltaTime) {
+			PHYSICS2D_PROFILE_ZONE("simulate");
+			totalTime += deltaTime;
+			spheres[0].position += glm::vec2(moveX, moveY) * deltaTime;
+			if (moveX != 0 || moveY != 0)
 			{
-				glm::vec2 normal;
-				if (isSphereSphereCollision(spheres[ia], spheres[ib], normal))
-				{
-					spheres[ia].isColliding = true;
-					spheres[ib].isColliding = true;
-					spheres[ia].position = spheres[ia].oldPosition;
-					spheres[ib].position = spheres[ib].oldPosition;
-					reactCollision(spheres[ia], spheres[ib], normal);
-				}
-			}
-		}
-		
-		for (size_t ia = 0; ia < spheres.size(); ++ia)
-		{
-			for (size_t ib = 0; ib < boxes.size(); ++ib)
-			{
-				glm::vec2 normal;
-				if (isSphereAABBCollision(spheres[ia], boxes[ib], normal))
-				{
-					spheres[ia].isColliding = true;
-					boxes[ib].isColliding = true;
-					spheres[ia].position = spheres[ia].oldPosition;
-					boxes[ib].position = boxes[ib].oldPosition;
-					reactCollision(spheres[ia], boxes[ib], normal);
-				}
+				// Sphere proxies come after the boxes
+				world.wake(uint32_t(boxes.size()));
 			}
-		}
+			world.step(deltaTime);
+		});
+		const float alpha = fixedStep.getAlpha();
 
 		window.setScreen(-10, 10, -10, 10);
 		window.drawAxis();
@@ -261,22 +117,38 @@ int main() {
 		// float w = 1.0f;
 		// box1.rotation = box1.rotation + 0.5f * w * deltaTime;
 
-		for (const auto& box : boxes)
+		for (auto& box : boxes)
 		{
-			// getVertices from box and construct mikroplot::vec2 vertices
-			std::vector<mikroplot::vec2> points;
-			for (auto point : getVertices(box, 1.0))
 			{
-				points.push_back({ point.x, point.y });
+				PHYSICS2D_PROFILE_ZONE("getVertices");
+				// getVertices from box and construct mikroplot::vec2 vertices, drawn between the last two physics states
+				glm::vec2 offset = physics2d::interpolate(box.oldPosition, box.position, alpha) - box.position;
+				points.clear();
+				for (auto point : getWorldVertices(box))
+				{
+					points.push_back({ point.x + offset.x, point.y + offset.y });
+				}
 			}
+			PHYSICS2D_PROFILE_ZONE("drawLines");
 			window.drawLines(points, box.isColliding ? 8 : 11, 5);
 		}
 
 		for (const auto& sphere : spheres) {
-			window.drawCircle({ sphere.position.x, sphere.position.y }, sphere.radius, sphere.isColliding ? 8 : 11);
+			PHYSICS2D_PROFILE_ZONE("drawCircle");
+			glm::vec2 position = physics2d::interpolate(sphere.oldPosition, sphere.position, alpha);
+			window.drawCircle({ position.x, position.y }, sphere.radius, sphere.isColliding ? 8 : 11);
 		}
 
-		window.update();
+		if (showProfiler)
+		{
+			drawProfilerOverlay(window, profiler, { -9.8f, 6.0f }, { 8.0f, 3.5f });
+		}
+
+		{
+			PHYSICS2D_PROFILE_ZONE("Window::update");
+			window.update();
+		}
+		profiler.endFrame();
 	}
 
 	return 0;
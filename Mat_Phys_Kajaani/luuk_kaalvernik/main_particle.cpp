@@ -1,5 +1,6 @@
 #include <mikroplot/window.h>
 #include <glm/glm.hpp>
+#include <physics2d/fixed_timestep.h>
 
 ///
 /// \brief The Point class
@@ -85,26 +86,31 @@ int main() {
 	body.velocity.y = 10.0f;
 	body.velocity *= 0.5f;
 	float startDelay = 2.0f;
+
+	// Physics runs at a fixed 240 Hz no matter how fast the window renders
+	physics2d::FixedTimestep fixedStep(240.0f);
+	glm::vec2 oldPosition = body.position;
 	while (!window.shouldClose()) {
-		float dt = timer.getDeltaTime();
-		startDelay -= dt;
-		if (startDelay < 0.0f)
-		{
+		fixedStep.advance(timer.getDeltaTime(), [&](float dt) {
+			oldPosition = body.position;
+			startDelay -= dt;
+			if (startDelay < 0.0f)
+			{
+				body = simulate(body, dt);
+			}
+
+			// Update simulation
 			body = simulate(body, dt);
-		}
-
-		// Update simulation
-		body = simulate(body, dt);
+		});
 
-		// Construct point(s) to draw from body position(s)
-		std::vector<mikroplot::vec2> particlePosition;
-		particlePosition.push_back({ body.position.x, body.position.y });
+		// Draw between the last two physics states
+		glm::vec2 position = physics2d::interpolate(oldPosition, body.position, fixedStep.getAlpha());
 
 		// Render
 		window.setScreen(-1, 11, -1, 11);
 		window.drawAxis();
 		
-		window.drawPoints({vec2(body.position.x,body.position.y)}, 11, 10);
+		window.drawPoints({vec2(position.x,position.y)}, 11, 10);
 		window.update();
 	}
 
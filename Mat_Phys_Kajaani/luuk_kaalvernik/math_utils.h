@@ -24,58 +24,561 @@
 //// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
 //// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-= ////
+#pragma once
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <vector>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 namespace math {
-	template<typename V>
-	V add(const V& a, const V& b) {
-		V res = a;
-		for(size_t i=0; i<res.size(); ++i){
-			res[i] = a[i] + b[i];
-		}
-		return res;
+	///
+	/// Vector math for integrator states.
+	///
+	/// glm vectors and matrices, small std::arrays, complex numbers and scalars are
+	/// added and scaled right away. glm types use glm's operators, which use SSE/AVX
+	/// for the aligned qualifiers when GLM_FORCE_INTRINSICS is defined, and std::arrays
+	/// are unrolled over their compile time size. Other states indexed with size() and [], like
+	/// std::vector and big std::arrays, instead get a lazily evaluated expression. A whole sum such as
+	/// add(add(x, mul(a, k1)), mul(b, k2)) then runs as one loop when evaluate()d or
+	/// assign()ed, without a temporary state for every add and mul.
+	///
+	/// Expressions convert to their state type, so V x = add(a, b) still works. They
+	/// keep references to the states they were made from, so evaluate them before
+	/// those go out of scope, and do not keep them in an auto variable.
+	///
+	template<typename T>
+	concept IndexedState = requires(const T& state) {
+		state.size();
+		state[0];
+	};
+
+	template<typename T>
+	struct IsExpression : std::false_type {};
+
+	// Expressions are held by value, they are small and often temporaries. States are held by reference.
+	template<typename T>
+	using OperandStorage = std::conditional_t<IsExpression<T>::value, const T, const T&>;
+
+	template<typename T>
+	struct ResultOf {
+		using type = T;
+	};
+
+	template<typename T>
+		requires IsExpression<T>::value
+	struct ResultOf<T> {
+		using type = typename T::Result;
+	};
+
+	/// State type an expression evaluates to, the type itself for anything else.
+	template<typename T>
+	using Result = typename ResultOf<T>::type;
+
+	template<typename A, typename B>
+	struct AddExpression {
+		using Result = math::Result<A>;
+
+		OperandStorage<A> a;
+		OperandStorage<B> b;
+
+		size_t size() const { return a.size(); }
+		auto operator[](size_t i) const { return a[i] + b[i]; }
+		operator Result() const { return evaluate(*this); }
+	};
+
+	template<typename S, typename A>
+	struct MulExpression {
+		using Result = math::Result<A>;
+
+		S s;
+		OperandStorage<A> a;
+
+		size_t size() const { return a.size(); }
+		auto operator[](size_t i) const { return s * a[i]; }
+		operator Result() const { return evaluate(*this); }
+	};
+
+	template<typename A, typename B>
+	struct IsExpression<AddExpression<A, B>> : std::true_type {};
+
+	template<typename S, typename A>
+	struct IsExpression<MulExpression<S, A>> : std::true_type {};
+
+	template<IndexedState A, IndexedState B>
+	AddExpression<A, B> add(const A& a, const B& b) {
+		return { a, b };
 	}
 
-	template<typename S, typename V>
-	V mul(const S& a, const V& b) {
-		V res = b;
-		for(size_t i=0; i<res.size(); ++i){
-			res[i] = a * b[i];
+	template<typename S, IndexedState A>
+		requires (!IndexedState<S>)
+	MulExpression<S, A> mul(const S& s, const A& a) {
+		return { s, a };
+	}
+
+	///
+	/// \brief Calls f(std::integral_constant<size_t, i>()) for i from Begin to End - 1, unrolled at compile time.
+	///
+	template<size_t Begin, size_t End, typename Function>
+	inline void unroll(Function&& f) {
+		if constexpr (Begin < End)
+		{
+			f(std::integral_constant<size_t, Begin>());
+			unroll<Begin + 1, End>(f);
 		}
-		return res;
 	}
 
-	template<>
-	glm::vec2 add(const glm::vec2& a, const glm::vec2& b) {
+	///
+	/// \brief out = a + b for N values known at compile time, unrolled. out may be a or b.
+	///
+	/// Written as plain values rather than SSE/AVX intrinsics: the compiler packs the unrolled values
+	/// into registers itself, and intrinsics on a single small value only added stores and reloads
+	/// of the temporary between mul() and add(). Used for small std::arrays.
+	///
+	template<size_t N, typename T>
+	inline void addFixed(T* out, const T* a, const T* b) {
+		unroll<0, N>([&](size_t i) { out[i] = a[i] + b[i]; });
+	}
+
+	///
+	/// \brief out = s * a for N values known at compile time, unrolled. out may be a.
+	///
+	template<size_t N, typename T>
+	inline void mulFixed(T* out, T s, const T* a) {
+		unroll<0, N>([&](size_t i) { out[i] = s * a[i]; });
+	}
+
+	// glm types use glm's own operators. Those inline to the same code as a + s * b written by hand at
+	// any optimization level, while copying their values through addFixed() did not at -O2. With
+	// GLM_FORCE_INTRINSICS glm runs them with SSE/AVX for its aligned qualifiers.
+	template<glm::length_t L, typename T, glm::qualifier Q>
+	glm::vec<L, T, Q> add(const glm::vec<L, T, Q>& a, const glm::vec<L, T, Q>& b) {
 		return a + b;
 	}
 
-	template<>
-	glm::vec2 mul(const float& a, const glm::vec2& b) {
-		return a * b;
+	template<typename S, glm::length_t L, typename T, glm::qualifier Q>
+		requires std::is_arithmetic_v<S>
+	glm::vec<L, T, Q> mul(const S& s, const glm::vec<L, T, Q>& a) {
+		return T(s) * a;
 	}
 
-	template<>
-	glm::vec3 add(const glm::vec3& a, const glm::vec3& b) {
+	template<glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+	glm::mat<C, R, T, Q> add(const glm::mat<C, R, T, Q>& a, const glm::mat<C, R, T, Q>& b) {
 		return a + b;
 	}
 
-	template<>
-	glm::vec3 mul(const float& a, const glm::vec3& b) {
-		return a * b;
+	template<typename S, glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+		requires std::is_arithmetic_v<S>
+	glm::mat<C, R, T, Q> mul(const S& s, const glm::mat<C, R, T, Q>& a) {
+		return T(s) * a;
+	}
+
+	/// Largest std::array added and scaled right away, bigger ones become expressions like other indexed states
+	static constexpr size_t MaxFixedSize = 16;
+
+	template<typename T, size_t N>
+		requires std::is_arithmetic_v<T> && (N <= MaxFixedSize)
+	std::array<T, N> add(const std::array<T, N>& a, const std::array<T, N>& b) {
+		std::array<T, N> result;
+		addFixed<N>(result.data(), a.data(), b.data());
+		return result;
+	}
+
+	template<typename S, typename T, size_t N>
+		requires std::is_arithmetic_v<S> && std::is_arithmetic_v<T> && (N <= MaxFixedSize)
+	std::array<T, N> mul(const S& s, const std::array<T, N>& a) {
+		std::array<T, N> result;
+		mulFixed<N>(result.data(), T(s), a.data());
+		return result;
 	}
 
-	template<>
-	std::complex<float> add(const std::complex<float>& a, const std::complex<float>& b) {
+	template<typename T>
+	std::complex<T> add(const std::complex<T>& a, const std::complex<T>& b) {
 		return a + b;
 	}
 
-	template<>
-	std::complex<float> mul(const std::complex<float>& a, const std::complex<float>& b) {
+	template<typename T>
+	std::complex<T> mul(const std::complex<T>& a, const std::complex<T>& b) {
 		return a * b;
 	}
+
+	template<typename S, typename T>
+		requires std::is_arithmetic_v<S>
+	std::complex<T> mul(const S& s, const std::complex<T>& a) {
+		return T(s) * a;
+	}
+
+	template<typename T>
+		requires std::is_arithmetic_v<T>
+	T add(const T& a, const T& b) {
+		return a + b;
+	}
+
+	template<typename S, typename T>
+		requires std::is_arithmetic_v<S> && std::is_arithmetic_v<T>
+	T mul(const S& s, const T& a) {
+		return T(s) * a;
+	}
+
+	///
+	/// \brief Writes expression into state in one loop. state must already have the size of expression,
+	/// and may appear in expression itself.
+	///
+	template<typename V, typename E>
+	void assign(V& state, const E& expression) {
+		if constexpr (IsExpression<E>::value)
+		{
+			const size_t size = expression.size();
+			for (size_t i = 0; i < size; ++i)
+			{
+				state[i] = expression[i];
+			}
+		}
+		else
+		{
+			state = expression;
+		}
+	}
+
+	///
+	/// \brief Computes an expression into a new state. Anything else is returned as it is.
+	///
+	template<typename E>
+	Result<E> evaluate(const E& expression) {
+		if constexpr (IsExpression<E>::value)
+		{
+			Result<E> state{};
+			if constexpr (requires { state.resize(expression.size()); })
+			{
+				state.resize(expression.size());
+			}
+			assign(state, expression);
+			return state;
+		}
+		else
+		{
+			return expression;
+		}
+	}
+
+	///
+	/// \brief How a state is laid out in memory, when it is nothing but Count floats or doubles.
+	/// Scalar is void for anything else, like glm vectors padded for alignment.
+	///
+	template<typename V>
+	struct ScalarLayout {
+		using Scalar = void;
+		static constexpr size_t Count = 0;
+	};
+
+	template<typename T>
+		requires std::is_floating_point_v<T>
+	struct ScalarLayout<T> {
+		using Scalar = T;
+		static constexpr size_t Count = 1;
+	};
+
+	template<glm::length_t L, typename T, glm::qualifier Q>
+		requires std::is_floating_point_v<T> && (sizeof(glm::vec<L, T, Q>) == L * sizeof(T))
+	struct ScalarLayout<glm::vec<L, T, Q>> {
+		using Scalar = T;
+		static constexpr size_t Count = L;
+	};
+
+	template<glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+		requires std::is_floating_point_v<T> && (sizeof(glm::mat<C, R, T, Q>) == C * R * sizeof(T))
+	struct ScalarLayout<glm::mat<C, R, T, Q>> {
+		using Scalar = T;
+		static constexpr size_t Count = C * R;
+	};
+
+	template<typename T, size_t N>
+		requires std::is_floating_point_v<T>
+	struct ScalarLayout<std::array<T, N>> {
+		using Scalar = T;
+		static constexpr size_t Count = N;
+	};
+
+	///
+	/// \brief out[i] = x[i] + coefficients[0] * terms[0][i] + ... over count floats, 8 or 4 at a time. out may be x.
+	///
+	template<size_t N>
+	void scaledSum(float* out, const float* x, size_t count, const float (&coefficients)[N], const float* const (&terms)[N]) {
+		size_t i = 0;
+#if defined(__AVX__)
+		__m256 c[N];
+		for (size_t j = 0; j < N; ++j)
+		{
+			c[j] = _mm256_set1_ps(coefficients[j]);
+		}
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 sum = _mm256_loadu_ps(x + i);
+			for (size_t j = 0; j < N; ++j)
+			{
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(c[j], _mm256_loadu_ps(terms[j] + i)));
+			}
+			_mm256_storeu_ps(out + i, sum);
+		}
+#elif defined(__SSE2__) || defined(_M_X64)
+		__m128 c[N];
+		for (size_t j = 0; j < N; ++j)
+		{
+			c[j] = _mm_set1_ps(coefficients[j]);
+		}
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 sum = _mm_loadu_ps(x + i);
+			for (size_t j = 0; j < N; ++j)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(c[j], _mm_loadu_ps(terms[j] + i)));
+			}
+			_mm_storeu_ps(out + i, sum);
+		}
+#endif
+		// Remaining values that do not fill a whole register
+		for (; i < count; ++i)
+		{
+			float sum = x[i];
+			for (size_t j = 0; j < N; ++j)
+			{
+				sum += coefficients[j] * terms[j][i];
+			}
+			out[i] = sum;
+		}
+	}
+
+	///
+	/// \brief Same as above for doubles, 4 or 2 at a time.
+	///
+	template<size_t N>
+	void scaledSum(double* out, const double* x, size_t count, const double (&coefficients)[N], const double* const (&terms)[N]) {
+		size_t i = 0;
+#if defined(__AVX__)
+		__m256d c[N];
+		for (size_t j = 0; j < N; ++j)
+		{
+			c[j] = _mm256_set1_pd(coefficients[j]);
+		}
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256d sum = _mm256_loadu_pd(x + i);
+			for (size_t j = 0; j < N; ++j)
+			{
+				sum = _mm256_add_pd(sum, _mm256_mul_pd(c[j], _mm256_loadu_pd(terms[j] + i)));
+			}
+			_mm256_storeu_pd(out + i, sum);
+		}
+#elif defined(__SSE2__) || defined(_M_X64)
+		__m128d c[N];
+		for (size_t j = 0; j < N; ++j)
+		{
+			c[j] = _mm_set1_pd(coefficients[j]);
+		}
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128d sum = _mm_loadu_pd(x + i);
+			for (size_t j = 0; j < N; ++j)
+			{
+				sum = _mm_add_pd(sum, _mm_mul_pd(c[j], _mm_loadu_pd(terms[j] + i)));
+			}
+			_mm_storeu_pd(out + i, sum);
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			double sum = x[i];
+			for (size_t j = 0; j < N; ++j)
+			{
+				sum += coefficients[j] * terms[j][i];
+			}
+			out[i] = sum;
+		}
+	}
+
+	///
+	/// \brief Adds (value / (absolute + relative * max(|a|, |b|)))^2 of every scalar in value to sum,
+	/// and the number of scalars to count. Works for scalars, glm vectors, complex numbers and
+	/// indexed states of any of them.
+	///
+	template<typename V, typename S>
+	void accumulateScaledSquares(const V& value, const V& a, const V& b, S absolute, S relative, S& sum, size_t& count) {
+		if constexpr (std::is_arithmetic_v<V>)
+		{
+			const S scale = absolute + relative * std::max(S(std::abs(a)), S(std::abs(b)));
+			const S scaled = S(value) / scale;
+			sum += scaled * scaled;
+			++count;
+		}
+		else if constexpr (requires { value.real(); value.imag(); })
+		{
+			accumulateScaledSquares(value.real(), a.real(), b.real(), absolute, relative, sum, count);
+			accumulateScaledSquares(value.imag(), a.imag(), b.imag(), absolute, relative, sum, count);
+		}
+		else if constexpr (requires { V::length(); })
+		{
+			for (glm::length_t i = 0; i < V::length(); ++i)
+			{
+				accumulateScaledSquares(value[i], a[i], b[i], absolute, relative, sum, count);
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < value.size(); ++i)
+			{
+				accumulateScaledSquares(value[i], a[i], b[i], absolute, relative, sum, count);
+			}
+		}
+	}
+
+	///
+	/// \brief Root mean square of value scaled by the tolerance of every scalar, see accumulateScaledSquares().
+	/// Below 1 means value is within tolerance.
+	///
+	template<typename V, typename S>
+	S scaledNorm(const V& value, const V& a, const V& b, S absolute, S relative) {
+		S sum = 0;
+		size_t count = 0;
+		accumulateScaledSquares(value, a, b, absolute, relative, sum, count);
+		return count > 0 ? std::sqrt(sum / S(count)) : S(0);
+	}
+
+	///
+	/// \brief out[i] = x[i] + coefficients[0] * terms[0][i] + ... for spans of states of the same size.
+	/// States made of plain floats or doubles go through the SIMD loops above, others are added one by one.
+	///
+	template<typename V, typename S, size_t N>
+	void scaledSum(std::span<V> out, std::span<const V> x, const S (&coefficients)[N], const std::span<const V> (&terms)[N]) {
+		using Layout = ScalarLayout<V>;
+		if constexpr (!std::is_void_v<typename Layout::Scalar>)
+		{
+			using T = typename Layout::Scalar;
+			T scalarCoefficients[N];
+			const T* scalarTerms[N];
+			for (size_t j = 0; j < N; ++j)
+			{
+				scalarCoefficients[j] = T(coefficients[j]);
+				scalarTerms[j] = reinterpret_cast<const T*>(terms[j].data());
+			}
+			scaledSum(reinterpret_cast<T*>(out.data()), reinterpret_cast<const T*>(x.data()), x.size() * Layout::Count,
+				scalarCoefficients, scalarTerms);
+		}
+		else
+		{
+			for (size_t i = 0; i < x.size(); ++i)
+			{
+				V sum = x[i];
+				for (size_t j = 0; j < N; ++j)
+				{
+					sum = math::evaluate(math::add(sum, math::mul(coefficients[j], terms[j][i])));
+				}
+				out[i] = sum;
+			}
+		}
+	}
+
+	///
+	/// \brief Resizes state to the size of other, if it can be resized. Keeps the allocation when the size is the same.
+	///
+	template<typename V>
+	void resizeLike(V& state, const V& other) {
+		if constexpr (requires { state.resize(other.size()); })
+		{
+			if (state.size() != other.size())
+			{
+				state.resize(other.size());
+			}
+		}
+	}
+
+	///
+	/// \brief Row major N x N matrix for small linear systems, such as the Newton steps of the implicit integrators.
+	///
+	template<typename T, size_t N>
+	struct DenseMatrix {
+		std::array<T, N * N> values{};
+
+		T& operator()(size_t row, size_t column) { return values[row * N + column]; }
+		T operator()(size_t row, size_t column) const { return values[row * N + column]; }
+	};
+
+	///
+	/// \brief LU decomposition with partial pivoting in place, L below the diagonal with ones on it and U on and above it.
+	/// \param pivots = Receives the row swapped into each row.
+	/// \return false if the matrix is singular.
+	///
+	template<typename T, size_t N>
+	bool luDecompose(DenseMatrix<T, N>& matrix, std::array<size_t, N>& pivots) {
+		for (size_t column = 0; column < N; ++column)
+		{
+			size_t pivot = column;
+			for (size_t row = column + 1; row < N; ++row)
+			{
+				if (std::abs(matrix(row, column)) > std::abs(matrix(pivot, column)))
+				{
+					pivot = row;
+				}
+			}
+			pivots[column] = pivot;
+			if (matrix(pivot, column) == T(0))
+			{
+				return false;
+			}
+			if (pivot != column)
+			{
+				for (size_t j = 0; j < N; ++j)
+				{
+					std::swap(matrix(pivot, j), matrix(column, j));
+				}
+			}
+			const T inverse = T(1) / matrix(column, column);
+			for (size_t row = column + 1; row < N; ++row)
+			{
+				const T factor = matrix(row, column) * inverse;
+				matrix(row, column) = factor;
+				for (size_t j = column + 1; j < N; ++j)
+				{
+					matrix(row, j) -= factor * matrix(column, j);
+				}
+			}
+		}
+		return true;
+	}
+
+	///
+	/// \brief Solves matrix * x = b in place of b, with matrix and pivots from luDecompose().
+	///
+	template<typename T, size_t N>
+	void luSolve(const DenseMatrix<T, N>& matrix, const std::array<size_t, N>& pivots, T* b) {
+		for (size_t row = 0; row < N; ++row)
+		{
+			std::swap(b[row], b[pivots[row]]);
+			for (size_t j = 0; j < row; ++j)
+			{
+				b[row] -= matrix(row, j) * b[j];
+			}
+		}
+		for (size_t row = N; row-- > 0;)
+		{
+			for (size_t j = row + 1; j < N; ++j)
+			{
+				b[row] -= matrix(row, j) * b[j];
+			}
+			b[row] /= matrix(row, row);
+		}
+	}
 }
 
 /// Functions for integrion
@@ -83,7 +586,7 @@ namespace integrate {
 	// Linear step function for N-dimensions
 	template<typename S, typename V>
 	auto linStep(const V& x0, S dt, const V& dx) {
-		return math::add(x0, math::mul(dt, dx));
+		return math::evaluate(math::add(x0, math::mul(dt, dx)));
 	}
 
 	// Rotational step function for 2D
@@ -135,29 +638,1028 @@ namespace integrate {
 		// Kysy paljonko on f'(0)
 		auto dx0 = derive(x0, 0);
 		// laske f(0)+(x/2)*f'(0)
-		auto dx1 = step(x0, dt/S(2), dx0);
+		auto dx1 = linStep(x0, dt/S(2), dx0);
 		// Nyt voimme soveltaa keskipistemenetelmää
 		// Kysy paljonko on f'(x/2), kun f(x/2) tiedetään
 		dx0 = derive(dx1, dt/S(2));
 		// Laske paljonko on f(0)+x*f'(x/2)
-		return step(x0, dt, dx0);
+		return linStep(x0, dt, dx0);
 	}
 
 	template<typename S, typename V, typename DeriveFunc>
 	auto rungeKutta(const V& x0, S dt, DeriveFunc derive) {
-		auto k1 = math::mul(dt, derive(x0, 0));
-		auto t2 = step(x0, S(0.5), k1);
-		auto k2 = math::mul(dt, derive(t2, S(0.5) * dt));
-		auto t3 = step(x0, S(0.5), k2);
-		auto k3 = math::mul(dt, derive(t3, S(0.5) * dt));
-		auto t4 = math::add(x0, k3);
-		auto k4 = math::mul(dt, derive(t4, dt));
-		return math::add(math::add(math::add(math::add(x0,
-				math::mul(S(1.0/6.0), k1)),
-				math::mul(S(1.0/3.0), k2)),
-				math::mul(S(1.0/3.0), k3)),
-				math::mul(S(1.0/6.0), k4));
+		const S halfDt = S(0.5) * dt;
+		auto k1 = derive(x0, S(0));
+		auto k2 = derive(math::evaluate(math::add(x0, math::mul(halfDt, k1))), halfDt);
+		auto k3 = derive(math::evaluate(math::add(x0, math::mul(halfDt, k2))), halfDt);
+		auto k4 = derive(math::evaluate(math::add(x0, math::mul(dt, k3))), dt);
+		// Fused into a single pass over the state
+		return math::evaluate(math::add(math::add(math::add(math::add(x0,
+				math::mul(dt / S(6), k1)),
+				math::mul(dt / S(3), k2)),
+				math::mul(dt / S(3), k3)),
+				math::mul(dt / S(6), k4)));
+	}
+
+	///
+	/// \brief Stage states of rungeKutta(), kept between steps so big states are not reallocated.
+	///
+	template<typename V>
+	struct RungeKuttaWorkspace {
+		V k1, k2, k3, k4, x;
+	};
+
+	///
+	/// \brief Advances x in place by one RK4 step without allocating, once workspace has grown to the size of x.
+	/// \param derive = void(const V& x, S t, V& dx), writes the derivative at x into dx, which has the size of x.
+	///
+	template<typename S, typename V, typename DeriveFunc>
+	void rungeKutta(V& x, S dt, DeriveFunc derive, RungeKuttaWorkspace<V>& workspace) {
+		for (V* state : { &workspace.k1, &workspace.k2, &workspace.k3, &workspace.k4, &workspace.x })
+		{
+			math::resizeLike(*state, x);
+		}
+		const S halfDt = S(0.5) * dt;
+		derive(x, S(0), workspace.k1);
+		math::assign(workspace.x, math::add(x, math::mul(halfDt, workspace.k1)));
+		derive(workspace.x, halfDt, workspace.k2);
+		math::assign(workspace.x, math::add(x, math::mul(halfDt, workspace.k2)));
+		derive(workspace.x, halfDt, workspace.k3);
+		math::assign(workspace.x, math::add(x, math::mul(dt, workspace.k3)));
+		derive(workspace.x, dt, workspace.k4);
+		math::assign(x, math::add(math::add(math::add(math::add(x,
+				math::mul(dt / S(6), workspace.k1)),
+				math::mul(dt / S(3), workspace.k2)),
+				math::mul(dt / S(3), workspace.k3)),
+				math::mul(dt / S(6), workspace.k4)));
+	}
+
+	///
+	/// \brief Semi-implicit (symplectic) Euler step: velocity is kicked first and position drifts with the new velocity.
+	///
+	/// First order like eulerl(), but for forces that depend on position only it keeps the energy of
+	/// orbits and springs bounded instead of letting it grow every step.
+	///
+	/// \param accelerate = V(const P& position, S t), acceleration at position, t from the start of the step.
+	///
+	template<typename S, typename P, typename V, typename AccelerationFunc>
+	void semiImplicitEuler(P& position, V& velocity, S dt, AccelerationFunc accelerate) {
+		math::assign(velocity, math::add(velocity, math::mul(dt, accelerate(position, S(0)))));
+		math::assign(position, math::add(position, math::mul(dt, velocity)));
+	}
+
+	///
+	/// \brief Velocity Verlet step, second order and symplectic, with one evaluation of accelerate per step.
+	///
+	/// acceleration is the acceleration at position and is updated to the one at the new position,
+	/// so the next step reuses it. Set it to accelerate(position, 0) before the first step, and again
+	/// whenever position is changed outside the integrator, e.g. by a collision.
+	///
+	/// \param accelerate = V(const P& position, S t), acceleration at position, t from the start of the step.
+	///
+	template<typename S, typename P, typename V, typename AccelerationFunc>
+	void velocityVerlet(P& position, V& velocity, V& acceleration, S dt, AccelerationFunc accelerate) {
+		const S halfDt = S(0.5) * dt;
+		math::assign(velocity, math::add(velocity, math::mul(halfDt, acceleration)));
+		math::assign(position, math::add(position, math::mul(dt, velocity)));
+		acceleration = accelerate(position, dt);
+		math::assign(velocity, math::add(velocity, math::mul(halfDt, acceleration)));
+	}
+
+	///
+	/// \brief Leapfrog step in drift-kick-drift form: half a step of position, a full kick of velocity
+	/// at the middle and the other half of position. Second order and symplectic like velocityVerlet(),
+	/// without any acceleration to carry between steps.
+	///
+	/// \param accelerate = V(const P& position, S t), acceleration at position, t from the start of the step.
+	///
+	template<typename S, typename P, typename V, typename AccelerationFunc>
+	void leapfrog(P& position, V& velocity, S dt, AccelerationFunc accelerate) {
+		const S halfDt = S(0.5) * dt;
+		math::assign(position, math::add(position, math::mul(halfDt, velocity)));
+		math::assign(velocity, math::add(velocity, math::mul(dt, accelerate(position, halfDt))));
+		math::assign(position, math::add(position, math::mul(halfDt, velocity)));
+	}
+
+	///
+	/// \brief x + h * (c1 * k1 + c2 * k2 + ...) as a single expression, terms are (coefficient, derivative) pairs.
+	///
+	template<typename V, typename S>
+	V weightedSum(const V& x, S) {
+		return x;
+	}
+
+	template<typename V, typename S, typename K, typename... Terms>
+	auto weightedSum(const V& x, S h, S coefficient, const K& k, const Terms&... terms) {
+		return weightedSum(math::add(x, math::mul(h * coefficient, k)), h, terms...);
+	}
+
+	///
+	/// \brief Tolerances and step size limits of the adaptive integrators.
+	///
+	template<typename S>
+	struct AdaptiveSettings {
+		S absoluteTolerance = S(1e-6);
+		S relativeTolerance = S(1e-6);
+		S initialStep = S(0); // 0 estimates one from the derivative at the start
+		S minStep = S(0); // Steps this small are accepted whatever their error, 0 only stops at the float resolution of t
+		S maxStep = S(0); // 0 for no limit
+		S safety = S(0.9); // Share of the step size the error estimate allows that is taken
+		S minScale = S(0.2); // Smallest and largest change of the step size from one step to the next
+		S maxScale = S(10);
+	};
+
+	struct AdaptiveStats {
+		uint32_t accepted = 0;
+		uint32_t rejected = 0;
+		uint32_t evaluations = 0; // Calls of derive
+	};
+
+	///
+	/// \brief One accepted step of DormandPrince, which interpolates the solution anywhere inside it
+	/// with the same fourth order accuracy as the step itself.
+	///
+	template<typename S, typename V>
+	struct DenseStep {
+		S t0 = 0;
+		S dt = 0;
+		V r1, r2, r3, r4, r5; // Coefficients of the interpolating polynomial
+
+		V operator()(S t) const {
+			const S theta = dt > S(0) ? (t - t0) / dt : S(1);
+			const S theta1 = S(1) - theta;
+			return math::evaluate(math::add(r1, math::mul(theta, math::add(r2, math::mul(theta1,
+				math::add(r3, math::mul(theta, math::add(r4, math::mul(theta1, r5)))))))));
+		}
+	};
+
+	///
+	/// \brief Adaptive Dormand-Prince 5(4) integrator.
+	///
+	/// Every step is taken with the fifth order solution and checked with the embedded fourth order
+	/// one. Steps whose error is above the tolerances are retried shorter, and the next step size
+	/// follows the error with a PI controller, so smooth parts take long steps and only the hard
+	/// parts take short ones. The last derivative of a step is the first one of the next (FSAL), so
+	/// an accepted step costs 6 evaluations of derive.
+	///
+	/// advanceTo() steps past the requested time and interpolates back to it, so asking for the state
+	/// every frame does not cut the steps short. Keep one integrator per simulated system between frames.
+	///
+	/// Usage:
+	///   integrate::DormandPrince<float, glm::vec4> orbit(state);
+	///   state = orbit.advanceTo(time, [](const glm::vec4& x, float t) { return derivative(x); });
+	///
+	template<typename S, typename V>
+	class DormandPrince {
+	public:
+		explicit DormandPrince(const V& x0, S t0 = S(0), const AdaptiveSettings<S>& settings = AdaptiveSettings<S>())
+			: m_settings(settings)
+			, m_x(x0)
+			, m_t(t0)
+			, m_dt(settings.initialStep) {
+			m_step.t0 = t0;
+		}
+
+		///
+		/// \brief Integrates forward until time t and returns the state at t.
+		/// \param derive = V(const V& x, S t), derivative of the state at time t.
+		/// t must not be before the start of the last step.
+		///
+		template<typename DeriveFunc>
+		V advanceTo(S t, DeriveFunc derive) {
+			start(derive);
+			while (m_t < t)
+			{
+				step(derive);
+			}
+			return t == m_t || m_stats.accepted == 0 ? m_x : m_step(t);
+		}
+
+		///
+		/// \brief Takes one accepted step, retrying shorter ones until the error is within tolerance.
+		///
+		template<typename DeriveFunc>
+		void step(DeriveFunc derive);
+
+		const V& getState() const { return m_x; }
+		S getTime() const { return m_t; }
+		S getStepSize() const { return m_dt; }
+		const AdaptiveStats& getStats() const { return m_stats; }
+		const DenseStep<S, V>& getLastStep() const { return m_step; }
+
+	private:
+		template<typename DeriveFunc>
+		void start(DeriveFunc derive);
+
+		AdaptiveSettings<S> m_settings;
+		AdaptiveStats m_stats;
+		V m_x;
+		V m_k1; // Derivative at m_x, the last stage of the previous step
+		V m_stage;
+		S m_t;
+		S m_dt;
+		S m_previousError = S(1e-4);
+		bool m_started = false;
+		DenseStep<S, V> m_step;
+	};
+
+	template<typename S, typename V>
+	template<typename DeriveFunc>
+	void DormandPrince<S, V>::start(DeriveFunc derive) {
+		if (m_started)
+		{
+			return;
+		}
+		m_started = true;
+		m_k1 = derive(m_x, m_t);
+		++m_stats.evaluations;
+		if (m_dt > S(0))
+		{
+			return;
+		}
+
+		// Initial step from the size of the state and of its first two derivatives (Hairer, Norsett and Wanner)
+		const S absolute = m_settings.absoluteTolerance;
+		const S relative = m_settings.relativeTolerance;
+		const S stateSize = math::scaledNorm(m_x, m_x, m_x, absolute, relative);
+		const S derivativeSize = math::scaledNorm(m_k1, m_x, m_x, absolute, relative);
+		S h = stateSize < S(1e-5) || derivativeSize < S(1e-5) ? S(1e-6) : S(0.01) * stateSize / derivativeSize;
+		m_stage = math::evaluate(math::add(m_x, math::mul(h, m_k1)));
+		const V k2 = derive(m_stage, m_t + h);
+		++m_stats.evaluations;
+		const S secondDerivativeSize = math::scaledNorm(math::evaluate(math::add(k2, math::mul(S(-1), m_k1))), m_x, m_x, absolute, relative) / h;
+		const S largest = std::max(derivativeSize, secondDerivativeSize);
+		const S estimate = largest <= S(1e-15) ? std::max(S(1e-6), h * S(1e-3)) : std::pow(S(0.01) / largest, S(1) / S(5));
+		m_dt = std::min(S(100) * h, estimate);
+	}
+
+	template<typename S, typename V>
+	template<typename DeriveFunc>
+	void DormandPrince<S, V>::step(DeriveFunc derive) {
+		start(derive);
+		// Dormand-Prince 5(4) coefficients
+		const S a21 = S(1) / S(5);
+		const S a31 = S(3) / S(40), a32 = S(9) / S(40);
+		const S a41 = S(44) / S(45), a42 = S(-56) / S(15), a43 = S(32) / S(9);
+		const S a51 = S(19372) / S(6561), a52 = S(-25360) / S(2187), a53 = S(64448) / S(6561), a54 = S(-212) / S(729);
+		const S a61 = S(9017) / S(3168), a62 = S(-355) / S(33), a63 = S(46732) / S(5247), a64 = S(49) / S(176), a65 = S(-5103) / S(18656);
+		const S b1 = S(35) / S(384), b3 = S(500) / S(1113), b4 = S(125) / S(192), b5 = S(-2187) / S(6784), b6 = S(11) / S(84);
+		// Fifth minus fourth order weights
+		const S e1 = S(71) / S(57600), e3 = S(-71) / S(16695), e4 = S(71) / S(1920), e5 = S(-17253) / S(339200), e6 = S(22) / S(525), e7 = S(-1) / S(40);
+		// Dense output weights
+		const S d1 = S(-12715105075.0) / S(11282082432.0), d3 = S(87487479700.0) / S(32700410799.0), d4 = S(-10690763975.0) / S(1880347072.0),
+			d5 = S(701980252875.0) / S(199316789632.0), d6 = S(-1453857185.0) / S(822651844.0), d7 = S(69997945.0) / S(29380423.0);
+
+		// Below this a step no longer moves t
+		const S resolution = S(16) * std::numeric_limits<S>::epsilon() * std::max(S(1), std::abs(m_t));
+		const S minStep = std::max(m_settings.minStep, resolution);
+		bool rejected = false;
+		for (;;)
+		{
+			S h = std::max(m_dt, minStep);
+			if (m_settings.maxStep > S(0))
+			{
+				h = std::min(h, m_settings.maxStep);
+			}
+			const V& k1 = m_k1;
+			const V k2 = derive(math::evaluate(weightedSum(m_x, h, a21, k1)), m_t + h / S(5));
+			const V k3 = derive(math::evaluate(weightedSum(m_x, h, a31, k1, a32, k2)), m_t + h * S(3) / S(10));
+			const V k4 = derive(math::evaluate(weightedSum(m_x, h, a41, k1, a42, k2, a43, k3)), m_t + h * S(4) / S(5));
+			const V k5 = derive(math::evaluate(weightedSum(m_x, h, a51, k1, a52, k2, a53, k3, a54, k4)), m_t + h * S(8) / S(9));
+			const V k6 = derive(math::evaluate(weightedSum(m_x, h, a61, k1, a62, k2, a63, k3, a64, k4, a65, k5)), m_t + h);
+			m_stage = math::evaluate(weightedSum(m_x, h, b1, k1, b3, k3, b4, k4, b5, k5, b6, k6));
+			const V k7 = derive(m_stage, m_t + h);
+			m_stats.evaluations += 6;
+
+			// Difference of the two solutions, as zero plus the weighted derivatives
+			const V difference = math::evaluate(weightedSum(math::evaluate(math::mul(S(0), m_x)), h, e1, k1, e3, k3, e4, k4, e5, k5, e6, k6, e7, k7));
+			const S error = math::scaledNorm(difference, m_x, m_stage, m_settings.absoluteTolerance, m_settings.relativeTolerance);
+			if (error > S(1) && h > minStep)
+			{
+				// Too big, retry with a shorter step and never grow right after a rejection
+				++m_stats.rejected;
+				rejected = true;
+				m_dt = h * std::max(m_settings.minScale, m_settings.safety * std::pow(error, S(-0.2)));
+				continue;
+			}
+
+			// Polynomial through both ends of the step, from the dense output of Dormand and Prince
+			m_step.t0 = m_t;
+			m_step.dt = h;
+			m_step.r1 = m_x;
+			m_step.r2 = math::evaluate(math::add(m_stage, math::mul(S(-1), m_x)));
+			m_step.r3 = math::evaluate(math::add(math::mul(h, k1), math::mul(S(-1), m_step.r2)));
+			m_step.r4 = math::evaluate(math::add(math::add(m_step.r2, math::mul(-h, k7)), math::mul(S(-1), m_step.r3)));
+			m_step.r5 = math::evaluate(weightedSum(math::evaluate(math::mul(S(0), m_x)), h, d1, k1, d3, k3, d4, k4, d5, k5, d6, k6, d7, k7));
+
+			std::swap(m_x, m_stage);
+			m_k1 = k7;
+			m_t += h;
+			++m_stats.accepted;
+
+			// PI step size controller with the gains of Hairer's DOPRI5
+			const S beta = S(0.04);
+			S scale = m_settings.safety * std::pow(std::max(error, S(1e-10)), -(S(0.2) - S(0.75) * beta)) * std::pow(m_previousError, beta);
+			scale = std::clamp(scale, m_settings.minScale, rejected ? S(1) : m_settings.maxScale);
+			m_previousError = std::max(error, S(1e-4));
+			m_dt = h * scale;
+			return;
+		}
+	}
+
+	///
+	/// \brief Integrates x0 over duration with DormandPrince and returns the state at the end.
+	/// \param derive = V(const V& x, S t) with t from 0 to duration.
+	/// \param stats = Optional, receives the number of steps and derivative evaluations taken.
+	///
+	template<typename S, typename V, typename DeriveFunc>
+	V dormandPrince(const V& x0, S duration, DeriveFunc derive, const AdaptiveSettings<S>& settings = AdaptiveSettings<S>(), AdaptiveStats* stats = nullptr) {
+		DormandPrince<S, V> integrator(x0, S(0), settings);
+		V x = integrator.advanceTo(duration, derive);
+		if (stats != nullptr)
+		{
+			*stats = integrator.getStats();
+		}
+		return x;
+	}
+}
+
+/// Butcher tableaus of explicit Runge-Kutta methods for integrate::explicitRK(). Each is a struct with
+/// the number of Stages, the stage weights a[i][j] (j < i), the solution weights b and the stage times c.
+namespace integrate::tableau {
+	struct Euler {
+		static constexpr size_t Stages = 1;
+		static constexpr double a[Stages][Stages] = { { 0 } };
+		static constexpr double b[Stages] = { 1 };
+		static constexpr double c[Stages] = { 0 };
+	};
+
+	struct MidPoint {
+		static constexpr size_t Stages = 2;
+		static constexpr double a[Stages][Stages] = {
+			{ 0, 0 },
+			{ 0.5, 0 } };
+		static constexpr double b[Stages] = { 0, 1 };
+		static constexpr double c[Stages] = { 0, 0.5 };
+	};
+
+	struct Heun {
+		static constexpr size_t Stages = 2;
+		static constexpr double a[Stages][Stages] = {
+			{ 0, 0 },
+			{ 1, 0 } };
+		static constexpr double b[Stages] = { 0.5, 0.5 };
+		static constexpr double c[Stages] = { 0, 1 };
+	};
+
+	// Classic fourth order Runge-Kutta, the method of integrate::rungeKutta()
+	struct RungeKutta4 {
+		static constexpr size_t Stages = 4;
+		static constexpr double a[Stages][Stages] = {
+			{ 0, 0, 0, 0 },
+			{ 0.5, 0, 0, 0 },
+			{ 0, 0.5, 0, 0 },
+			{ 0, 0, 1, 0 } };
+		static constexpr double b[Stages] = { 1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0 };
+		static constexpr double c[Stages] = { 0, 0.5, 0.5, 1 };
+	};
+
+	// Kutta's 3/8 rule, fourth order with smaller error constants than RungeKutta4
+	struct RungeKutta38 {
+		static constexpr size_t Stages = 4;
+		static constexpr double a[Stages][Stages] = {
+			{ 0, 0, 0, 0 },
+			{ 1.0 / 3.0, 0, 0, 0 },
+			{ -1.0 / 3.0, 1, 0, 0 },
+			{ 1, -1, 1, 0 } };
+		static constexpr double b[Stages] = { 1.0 / 8.0, 3.0 / 8.0, 3.0 / 8.0, 1.0 / 8.0 };
+		static constexpr double c[Stages] = { 0, 1.0 / 3.0, 2.0 / 3.0, 1 };
+	};
+
+	// Third order strong stability preserving method of Shu and Osher, for advection and other
+	// problems where a step must not overshoot
+	struct SspRungeKutta3 {
+		static constexpr size_t Stages = 3;
+		static constexpr double a[Stages][Stages] = {
+			{ 0, 0, 0 },
+			{ 1, 0, 0 },
+			{ 0.25, 0.25, 0 } };
+		static constexpr double b[Stages] = { 1.0 / 6.0, 1.0 / 6.0, 2.0 / 3.0 };
+		static constexpr double c[Stages] = { 0, 1, 0.5 };
+	};
+}
+
+namespace integrate {
+	///
+	/// \brief Weight of stage J in row Row of Tableau, where row Tableau::Stages is the solution weights b.
+	///
+	template<typename Tableau, size_t Row, size_t J>
+	constexpr double tableauWeight() {
+		if constexpr (Row == Tableau::Stages)
+		{
+			return Tableau::b[J];
+		}
+		else
+		{
+			return Tableau::a[Row][J];
+		}
+	}
+
+	///
+	/// \brief sum + dt * (w[Row][J] * k[J] + ... + w[Row][Row - 1] * k[Row - 1]) as one expression,
+	/// leaving out the stages whose weight is zero.
+	///
+	template<typename Tableau, size_t Row, size_t J = 0, typename S, typename E, typename K>
+	auto addStages(const E& sum, S dt, const K& k) {
+		if constexpr (J == Row)
+		{
+			return sum;
+		}
+		else if constexpr (tableauWeight<Tableau, Row, J>() == 0.0)
+		{
+			return addStages<Tableau, Row, J + 1>(sum, dt, k);
+		}
+		else
+		{
+			return addStages<Tableau, Row, J + 1>(math::add(sum, math::mul(S(tableauWeight<Tableau, Row, J>()) * dt, k[J])), dt, k);
+		}
+	}
+
+	///
+	/// \brief Computes the derivatives of stages Stage.. of Tableau into k.
+	///
+	template<typename Tableau, size_t Stage, typename S, typename V, typename DeriveFunc, typename K>
+	void explicitStages(const V& x0, S dt, DeriveFunc& derive, K& k) {
+		if constexpr (Stage < Tableau::Stages)
+		{
+			const S t = S(Tableau::c[Stage]) * dt;
+			if constexpr (Stage == 0)
+			{
+				k[Stage] = derive(x0, t);
+			}
+			else
+			{
+				k[Stage] = derive(math::evaluate(addStages<Tableau, Stage>(x0, dt, k)), t);
+			}
+			explicitStages<Tableau, Stage + 1>(x0, dt, derive, k);
+		}
+	}
+
+	///
+	/// \brief One step of the explicit Runge-Kutta method of Tableau, see integrate::tableau.
+	///
+	/// The stages are unrolled at compile time and stages with a zero weight are left out of the sums,
+	/// so the code is the same as a method written out by hand and switching methods costs nothing at run time.
+	///
+	/// Usage:
+	///   x = integrate::explicitRK<integrate::tableau::SspRungeKutta3>(x, dt, derive);
+	///
+	/// \param derive = V(const V& x, S t), derivative at x, t from the start of the step.
+	///
+	template<typename Tableau, typename S, typename V, typename DeriveFunc>
+	auto explicitRK(const V& x0, S dt, DeriveFunc derive) {
+		std::array<decltype(derive(x0, dt)), Tableau::Stages> k;
+		explicitStages<Tableau, 0>(x0, dt, derive, k);
+		return math::evaluate(addStages<Tableau, Tableau::Stages>(x0, dt, k));
+	}
+
+	///
+	/// \brief Passed instead of a Jacobian function to the implicit integrators to have it estimated from
+	/// derive with finite differences, one extra evaluation per state value or per linear iteration.
+	///
+	struct FiniteDifferenceJacobian {};
+
+	template<typename S>
+	struct ImplicitSettings {
+		uint32_t maxIterations = 10; // Newton iterations per step
+		S tolerance = S(1e-6); // Newton stops when no value of the residual or of the update is above tolerance * (1 + |value|)
+		uint32_t maxLinearIterations = 200; // Conjugate gradient iterations per Newton iteration
+		S linearTolerance = S(1e-6); // Conjugate gradient stops at this residual relative to the right hand side
+	};
+
+	struct ImplicitStats {
+		uint32_t iterations = 0; // Newton iterations
+		uint32_t linearIterations = 0; // Conjugate gradient iterations
+		uint32_t evaluations = 0; // Calls of derive
+		bool converged = true;
+	};
+
+	///
+	/// \brief Solves x1 = x0 + dt * ((1 - theta) * f(x0, 0) + theta * f(x1, dt)) for x1 with Newton
+	/// iterations and a dense LU of I - theta * dt * J. For fixed size states of floats or doubles,
+	/// see math::ScalarLayout. theta = 1 is backward Euler and theta = 0.5 the trapezoidal rule.
+	///
+	template<typename S, typename V, typename DeriveFunc, typename JacobianFunc>
+	V implicitStep(const V& x0, S dt, S theta, DeriveFunc derive, JacobianFunc jacobian, const ImplicitSettings<S>& settings, ImplicitStats* stats) {
+		using T = typename math::ScalarLayout<V>::Scalar;
+		constexpr size_t N = math::ScalarLayout<V>::Count;
+		static_assert(N > 0, "The dense implicit integrators need a state of floats or doubles, use the in place ones for big states");
+		auto values = [](auto& state) { return reinterpret_cast<std::conditional_t<std::is_const_v<std::remove_reference_t<decltype(state)>>, const T*, T*>>(&state); };
+
+		ImplicitStats result;
+		// Everything of the step that does not depend on x1
+		V known = x0;
+		if (theta < S(1))
+		{
+			known = math::evaluate(math::add(x0, math::mul(dt * (S(1) - theta), derive(x0, S(0)))));
+			++result.evaluations;
+		}
+
+		V x = x0;
+		math::DenseMatrix<T, N> matrix;
+		std::array<size_t, N> pivots;
+		T delta[N];
+		result.converged = false;
+		while (result.iterations < settings.maxIterations && !result.converged)
+		{
+			++result.iterations;
+			const V dx = derive(x, dt);
+			++result.evaluations;
+
+			// Residual of the implicit equation, done when it is already within tolerance
+			result.converged = true;
+			for (size_t row = 0; row < N; ++row)
+			{
+				delta[row] = values(known)[row] + T(theta * dt) * values(dx)[row] - values(x)[row];
+				result.converged = result.converged && std::abs(delta[row]) <= T(settings.tolerance) * (T(1) + std::abs(values(x)[row]));
+			}
+			if (result.converged)
+			{
+				break;
+			}
+
+			// Jacobian of derive at x, column by column when it is not given
+			if constexpr (std::is_same_v<JacobianFunc, FiniteDifferenceJacobian>)
+			{
+				for (size_t column = 0; column < N; ++column)
+				{
+					V probe = x;
+					const T step = std::sqrt(std::numeric_limits<T>::epsilon()) * std::max(T(1), std::abs(values(x)[column]));
+					values(probe)[column] += step;
+					const V probeDx = derive(probe, dt);
+					++result.evaluations;
+					for (size_t row = 0; row < N; ++row)
+					{
+						matrix(row, column) = (values(probeDx)[row] - values(dx)[row]) / step;
+					}
+				}
+			}
+			else
+			{
+				jacobian(x, dt, matrix);
+			}
+
+			// Newton step: (I - theta * dt * J) delta = -(x - known - theta * dt * dx)
+			for (size_t row = 0; row < N; ++row)
+			{
+				for (size_t column = 0; column < N; ++column)
+				{
+					matrix(row, column) = (row == column ? T(1) : T(0)) - T(theta * dt) * matrix(row, column);
+				}
+			}
+			if (!math::luDecompose(matrix, pivots))
+			{
+				break;
+			}
+			math::luSolve(matrix, pivots, delta);
+
+			result.converged = true;
+			for (size_t i = 0; i < N; ++i)
+			{
+				values(x)[i] += delta[i];
+				result.converged = result.converged && std::abs(delta[i]) <= T(settings.tolerance) * (T(1) + std::abs(values(x)[i]));
+			}
+		}
+		if (stats != nullptr)
+		{
+			*stats = result;
+		}
+		return x;
+	}
+
+	///
+	/// \brief Backward (implicit) Euler step, first order and stable at any dt for stiff systems such as
+	/// stiff springs, where it also damps the fast oscillations away.
+	///
+	/// Linear systems are solved by the first Newton iteration and the second only checks the residual,
+	/// others take a few. Each iteration evaluates derive once and, with the default
+	/// FiniteDifferenceJacobian, once more per state value.
+	///
+	/// \param derive = V(const V& x, S t), derivative at x, t from the start of the step.
+	/// \param jacobian = void(const V& x, S t, math::DenseMatrix<T, N>& J), writes the derivative of derive
+	/// with respect to x, J(i, j) = d derive_i / d x_j, where T and N are given by math::ScalarLayout<V>.
+	///
+	template<typename S, typename V, typename DeriveFunc, typename JacobianFunc = FiniteDifferenceJacobian>
+		requires (math::ScalarLayout<V>::Count > 0)
+	V backwardEuler(const V& x0, S dt, DeriveFunc derive, JacobianFunc jacobian = JacobianFunc(),
+		const ImplicitSettings<S>& settings = ImplicitSettings<S>(), ImplicitStats* stats = nullptr) {
+		return implicitStep(x0, dt, S(1), derive, jacobian, settings, stats);
+	}
+
+	///
+	/// \brief Trapezoidal (Crank-Nicolson) step, second order and stable at any dt, see backwardEuler()
+	/// for the arguments. Unlike backwardEuler() it keeps the energy of oscillations, fast ones included,
+	/// so use backwardEuler() when those should die out.
+	///
+	template<typename S, typename V, typename DeriveFunc, typename JacobianFunc = FiniteDifferenceJacobian>
+		requires (math::ScalarLayout<V>::Count > 0)
+	V trapezoidal(const V& x0, S dt, DeriveFunc derive, JacobianFunc jacobian = JacobianFunc(),
+		const ImplicitSettings<S>& settings = ImplicitSettings<S>(), ImplicitStats* stats = nullptr) {
+		return implicitStep(x0, dt, S(0.5), derive, jacobian, settings, stats);
+	}
+
+	///
+	/// \brief Work states of the in place implicit integrators, kept between steps so big states are not reallocated.
+	///
+	template<typename V>
+	struct ImplicitWorkspace {
+		V known, dx, delta, r, p, ap, probe, probeDx;
+	};
+
+	template<typename V>
+	auto dot(const V& a, const V& b) {
+		decltype(a[0] * b[0]) sum = 0;
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			sum += a[i] * b[i];
+		}
+		return sum;
+	}
+
+	///
+	/// \brief In place version of implicitStep() for big states, such as a std::vector of floats, that
+	/// solves each Newton step with conjugate gradients instead of a dense matrix.
+	///
+	/// Conjugate gradients need I - theta * dt * J to be symmetric positive definite, which holds when
+	/// J is symmetric with no positive eigenvalues, as for diffusion and for forces from a potential
+	/// integrated on positions alone. The Jacobian is only used through products with it.
+	///
+	template<typename S, typename V, typename DeriveFunc, typename JacobianTimesFunc>
+	void implicitStep(V& x, S dt, S theta, DeriveFunc derive, ImplicitWorkspace<V>& w, JacobianTimesFunc jacobianTimes,
+		const ImplicitSettings<S>& settings, ImplicitStats* stats) {
+		using T = std::remove_cvref_t<decltype(x[0])>;
+		for (V* state : { &w.known, &w.dx, &w.delta, &w.r, &w.p, &w.ap, &w.probe, &w.probeDx })
+		{
+			math::resizeLike(*state, x);
+		}
+		const size_t n = x.size();
+		const T scale = T(theta * dt);
+
+		ImplicitStats result;
+		math::assign(w.known, x);
+		if (theta < S(1))
+		{
+			derive(x, S(0), w.dx);
+			++result.evaluations;
+			math::assign(w.known, math::add(x, math::mul(dt * (S(1) - theta), w.dx)));
+		}
+
+		// ap = (I - theta * dt * J) p, J from jacobianTimes or the change of derive along p
+		auto multiply = [&](const V& p, V& ap) {
+			if constexpr (std::is_same_v<JacobianTimesFunc, FiniteDifferenceJacobian>)
+			{
+				const T length = std::sqrt(dot(p, p));
+				const T step = length > T(0) ? std::sqrt(std::numeric_limits<T>::epsilon()) * (T(1) + std::sqrt(dot(x, x) / T(n))) / length : T(0);
+				math::assign(w.probe, math::add(x, math::mul(step, p)));
+				derive(w.probe, dt, w.probeDx);
+				++result.evaluations;
+				for (size_t i = 0; i < n; ++i)
+				{
+					ap[i] = p[i] - (step > T(0) ? scale * (w.probeDx[i] - w.dx[i]) / step : T(0));
+				}
+			}
+			else
+			{
+				jacobianTimes(x, dt, p, ap);
+				math::assign(ap, math::add(p, math::mul(-scale, ap)));
+			}
+		};
+
+		result.converged = false;
+		while (result.iterations < settings.maxIterations && !result.converged)
+		{
+			++result.iterations;
+			derive(x, dt, w.dx);
+			++result.evaluations;
+
+			// Conjugate gradients for (I - theta * dt * J) delta = known + theta * dt * dx - x, from delta = 0,
+			// unless the residual is already within tolerance
+			math::assign(w.r, math::add(math::add(w.known, math::mul(scale, w.dx)), math::mul(T(-1), x)));
+			result.converged = true;
+			for (size_t i = 0; i < n && result.converged; ++i)
+			{
+				result.converged = std::abs(w.r[i]) <= T(settings.tolerance) * (T(1) + std::abs(x[i]));
+			}
+			if (result.converged)
+			{
+				break;
+			}
+			std::fill(w.delta.begin(), w.delta.end(), T(0));
+			math::assign(w.p, w.r);
+			T rr = dot(w.r, w.r);
+			const T stop = T(settings.linearTolerance * settings.linearTolerance) * rr;
+			for (uint32_t i = 0; i < settings.maxLinearIterations && rr > stop && rr > T(0); ++i)
+			{
+				++result.linearIterations;
+				multiply(w.p, w.ap);
+				const T pap = dot(w.p, w.ap);
+				if (pap <= T(0))
+				{
+					break; // Not positive definite, keep what was found so far
+				}
+				const T alpha = rr / pap;
+				math::assign(w.delta, math::add(w.delta, math::mul(alpha, w.p)));
+				math::assign(w.r, math::add(w.r, math::mul(-alpha, w.ap)));
+				const T next = dot(w.r, w.r);
+				math::assign(w.p, math::add(w.r, math::mul(next / rr, w.p)));
+				rr = next;
+			}
+
+			result.converged = true;
+			for (size_t i = 0; i < n; ++i)
+			{
+				x[i] += w.delta[i];
+				result.converged = result.converged && std::abs(w.delta[i]) <= T(settings.tolerance) * (T(1) + std::abs(x[i]));
+			}
+		}
+		if (stats != nullptr)
+		{
+			*stats = result;
+		}
+	}
+
+	///
+	/// \brief In place backward Euler step of a big state, see the in place implicitStep().
+	/// \param derive = void(const V& x, S t, V& dx), writes the derivative at x into dx, which has the size of x.
+	/// \param jacobianTimes = void(const V& x, S t, const V& v, V& out), writes J * v into out where J is the
+	/// Jacobian of derive at x. Leave out to estimate it with one extra evaluation of derive.
+	///
+	template<typename S, typename V, typename DeriveFunc, typename JacobianTimesFunc = FiniteDifferenceJacobian>
+	void backwardEuler(V& x, S dt, DeriveFunc derive, ImplicitWorkspace<V>& workspace, JacobianTimesFunc jacobianTimes = JacobianTimesFunc(),
+		const ImplicitSettings<S>& settings = ImplicitSettings<S>(), ImplicitStats* stats = nullptr) {
+		implicitStep(x, dt, S(1), derive, workspace, jacobianTimes, settings, stats);
+	}
+
+	///
+	/// \brief In place trapezoidal step of a big state, see backwardEuler() above for the arguments.
+	///
+	template<typename S, typename V, typename DeriveFunc, typename JacobianTimesFunc = FiniteDifferenceJacobian>
+	void trapezoidal(V& x, S dt, DeriveFunc derive, ImplicitWorkspace<V>& workspace, JacobianTimesFunc jacobianTimes = JacobianTimesFunc(),
+		const ImplicitSettings<S>& settings = ImplicitSettings<S>(), ImplicitStats* stats = nullptr) {
+		implicitStep(x, dt, S(0.5), derive, workspace, jacobianTimes, settings, stats);
 	}
 }
 
+/// Integrators advancing many independent states, like the particles of an emitter, in one call
+namespace integrate::batch {
+	///
+	/// \brief Runs every chunk on the calling thread. Anything with the same run(), such as
+	/// physics2d::JobSystem, can be passed to the batched integrators instead to spread the chunks over threads.
+	///
+	struct SerialChunks {
+		template<typename Task>
+		void run(uint32_t chunkCount, const Task& task) const {
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				task(chunk);
+			}
+		}
+	};
+
+	static constexpr size_t DefaultChunkSize = 1024;
+
+	///
+	/// \brief Stage derivatives of the batched integrators, kept between steps so they are not reallocated.
+	///
+	template<typename V>
+	struct Workspace {
+		std::vector<V> k1, k2, k3, k4, x;
+	};
+
+	///
+	/// \brief How the batched integrators slice and combine a batch of states. Two layouts are supported:
+	/// std::span<V> of whole states, and std::array<std::span<T>, C> of C component arrays (structure of
+	/// arrays) of the same length, where state i is made of element i of every array.
+	///
+	template<typename States>
+	struct BatchTraits;
+
+	template<typename V>
+	struct BatchTraits<std::span<V>> {
+		using Value = V; // Element type of the workspace
+		using ConstStates = std::span<const V>;
+
+		static size_t size(const std::span<V>& states) { return states.size(); }
+		static size_t storageSize(const std::span<V>& states) { return states.size(); }
+		static std::span<V> slice(const std::span<V>& states, size_t begin, size_t size) { return states.subspan(begin, size); }
+		static ConstStates toConst(const std::span<V>& states) { return states; }
+
+		static std::span<V> stage(std::vector<V>& storage, const std::span<V>&, size_t begin, size_t size) {
+			return std::span<V>(storage.data() + begin, size);
+		}
+
+		template<typename S, size_t N>
+		static void scaledSum(const std::span<V>& out, const std::span<V>& x, const S (&coefficients)[N], const std::span<V> (&terms)[N]) {
+			std::span<const V> constTerms[N];
+			std::copy(std::begin(terms), std::end(terms), constTerms);
+			math::scaledSum<V, S, N>(out, x, coefficients, constTerms);
+		}
+	};
+
+	template<typename T, size_t C>
+	struct BatchTraits<std::array<std::span<T>, C>> {
+		using Value = T;
+		using States = std::array<std::span<T>, C>;
+		using ConstStates = std::array<std::span<const T>, C>;
+
+		static size_t size(const States& states) { return states[0].size(); }
+		static size_t storageSize(const States& states) { return C * states[0].size(); }
+
+		static States slice(const States& states, size_t begin, size_t size) {
+			States result;
+			for (size_t c = 0; c < C; ++c)
+			{
+				result[c] = states[c].subspan(begin, size);
+			}
+			return result;
+		}
+
+		static ConstStates toConst(const States& states) {
+			ConstStates result;
+			std::copy(states.begin(), states.end(), result.begin());
+			return result;
+		}
+
+		// Component c of the workspace starts at c times the number of states
+		static States stage(std::vector<T>& storage, const States& states, size_t begin, size_t size) {
+			States result;
+			for (size_t c = 0; c < C; ++c)
+			{
+				result[c] = std::span<T>(storage.data() + c * states[0].size() + begin, size);
+			}
+			return result;
+		}
+
+		template<typename S, size_t N>
+		static void scaledSum(const States& out, const States& x, const S (&coefficients)[N], const States (&terms)[N]) {
+			for (size_t c = 0; c < C; ++c)
+			{
+				std::span<const T> componentTerms[N];
+				for (size_t j = 0; j < N; ++j)
+				{
+					componentTerms[j] = terms[j][c];
+				}
+				math::scaledSum<T, S, N>(out[c], x[c], coefficients, componentTerms);
+			}
+		}
+	};
+
+	///
+	/// \brief Calls step(begin, size) for consecutive ranges of count states, chunkSize at a time.
+	///
+	template<typename Chunks, typename Step>
+	void forEachChunk(size_t count, Chunks& chunks, size_t chunkSize, Step step) {
+		chunkSize = std::max<size_t>(1, chunkSize);
+		const uint32_t chunkCount = uint32_t((count + chunkSize - 1) / chunkSize);
+		chunks.run(chunkCount, [&](uint32_t chunk) {
+			const size_t begin = size_t(chunk) * chunkSize;
+			step(begin, std::min(chunkSize, count - begin));
+		});
+	}
+
+	///
+	/// \brief Explicit Euler step of every state.
+	/// \param states = std::span<V> or std::array<std::span<T>, C>, see BatchTraits.
+	/// \param derive = void(ConstStates x, S t, States dx), writes the derivatives of a range of states into dx,
+	/// where ConstStates is States with const elements. It may only read the states it is given, and is
+	/// called from many threads when chunks runs chunks in parallel.
+	///
+	template<typename S, typename States, typename DeriveFunc, typename Chunks = SerialChunks>
+	void eulerl(States states, S dt, DeriveFunc derive, Workspace<typename BatchTraits<States>::Value>& workspace,
+		Chunks&& chunks = Chunks(), size_t chunkSize = DefaultChunkSize) {
+		using Traits = BatchTraits<States>;
+		workspace.k1.resize(Traits::storageSize(states));
+		forEachChunk(Traits::size(states), chunks, chunkSize, [&](size_t begin, size_t size) {
+			const States x = Traits::slice(states, begin, size);
+			const States k1 = Traits::stage(workspace.k1, states, begin, size);
+			derive(Traits::toConst(x), S(0), k1);
+			Traits::scaledSum(x, x, { dt }, { k1 });
+		});
+	}
+
+	///
+	/// \brief Midpoint step of every state, see eulerl() for the arguments.
+	///
+	template<typename S, typename States, typename DeriveFunc, typename Chunks = SerialChunks>
+	void midPoint(States states, S dt, DeriveFunc derive, Workspace<typename BatchTraits<States>::Value>& workspace,
+		Chunks&& chunks = Chunks(), size_t chunkSize = DefaultChunkSize) {
+		using Traits = BatchTraits<States>;
+		workspace.k1.resize(Traits::storageSize(states));
+		workspace.x.resize(Traits::storageSize(states));
+		const S halfDt = S(0.5) * dt;
+		forEachChunk(Traits::size(states), chunks, chunkSize, [&](size_t begin, size_t size) {
+			const States x = Traits::slice(states, begin, size);
+			const States k = Traits::stage(workspace.k1, states, begin, size);
+			const States middle = Traits::stage(workspace.x, states, begin, size);
+			derive(Traits::toConst(x), S(0), k);
+			Traits::scaledSum(middle, x, { halfDt }, { k });
+			derive(Traits::toConst(middle), halfDt, k);
+			Traits::scaledSum(x, x, { dt }, { k });
+		});
+	}
+
+	///
+	/// \brief Classic fourth order Runge-Kutta step of every state, see eulerl() for the arguments.
+	/// Each chunk runs all four stages while its states are still in cache.
+	///
+	template<typename S, typename States, typename DeriveFunc, typename Chunks = SerialChunks>
+	void rungeKutta(States states, S dt, DeriveFunc derive, Workspace<typename BatchTraits<States>::Value>& workspace,
+		Chunks&& chunks = Chunks(), size_t chunkSize = DefaultChunkSize) {
+		using Traits = BatchTraits<States>;
+		for (auto* stage : { &workspace.k1, &workspace.k2, &workspace.k3, &workspace.k4, &workspace.x })
+		{
+			stage->resize(Traits::storageSize(states));
+		}
+		const S halfDt = S(0.5) * dt;
+		forEachChunk(Traits::size(states), chunks, chunkSize, [&](size_t begin, size_t size) {
+			const States x = Traits::slice(states, begin, size);
+			const States k1 = Traits::stage(workspace.k1, states, begin, size);
+			const States k2 = Traits::stage(workspace.k2, states, begin, size);
+			const States k3 = Traits::stage(workspace.k3, states, begin, size);
+			const States k4 = Traits::stage(workspace.k4, states, begin, size);
+			const States stage = Traits::stage(workspace.x, states, begin, size);
+			derive(Traits::toConst(x), S(0), k1);
+			Traits::scaledSum(stage, x, { halfDt }, { k1 });
+			derive(Traits::toConst(stage), halfDt, k2);
+			Traits::scaledSum(stage, x, { halfDt }, { k2 });
+			derive(Traits::toConst(stage), halfDt, k3);
+			Traits::scaledSum(stage, x, { dt }, { k3 });
+			derive(Traits::toConst(stage), dt, k4);
+			Traits::scaledSum(x, x, { dt / S(6), dt / S(3), dt / S(3), dt / S(6) }, { k1, k2, k3, k4 });
+		});
+	}
+
+	///
+	/// \brief Semi-implicit Euler step of every (position, velocity) pair, see integrate::semiImplicitEuler().
+	/// \param positions, velocities = The same layout, std::span<V> or std::array<std::span<T>, C>, see BatchTraits.
+	/// \param accelerate = void(ConstStates positions, S t, States accelerations), writes the accelerations of a range
+	/// of positions. Like derive of eulerl(), it may only read the positions it is given.
+	///
+	template<typename S, typename States, typename AccelerationFunc, typename Chunks = SerialChunks>
+	void semiImplicitEuler(States positions, States velocities, S dt, AccelerationFunc accelerate,
+		Workspace<typename BatchTraits<States>::Value>& workspace, Chunks&& chunks = Chunks(), size_t chunkSize = DefaultChunkSize) {
+		using Traits = BatchTraits<States>;
+		workspace.k1.resize(Traits::storageSize(velocities));
+		forEachChunk(Traits::size(positions), chunks, chunkSize, [&](size_t begin, size_t size) {
+			const States x = Traits::slice(positions, begin, size);
+			const States v = Traits::slice(velocities, begin, size);
+			const States a = Traits::stage(workspace.k1, velocities, begin, size);
+			accelerate(Traits::toConst(x), S(0), a);
+			Traits::scaledSum(v, v, { dt }, { a });
+			Traits::scaledSum(x, x, { dt }, { v });
+		});
+	}
+
+	///
+	/// \brief Velocity Verlet step of every (position, velocity) pair, see integrate::velocityVerlet().
+	/// accelerations has the layout of velocities and carries the accelerations from one step to the next,
+	/// fill it with accelerate before the first step. See semiImplicitEuler() for the other arguments.
+	///
+	template<typename S, typename States, typename AccelerationFunc, typename Chunks = SerialChunks>
+	void velocityVerlet(States positions, States velocities, States accelerations, S dt, AccelerationFunc accelerate,
+		Chunks&& chunks = Chunks(), size_t chunkSize = DefaultChunkSize) {
+		using Traits = BatchTraits<States>;
+		const S halfDt = S(0.5) * dt;
+		forEachChunk(Traits::size(positions), chunks, chunkSize, [&](size_t begin, size_t size) {
+			const States x = Traits::slice(positions, begin, size);
+			const States v = Traits::slice(velocities, begin, size);
+			const States a = Traits::slice(accelerations, begin, size);
+			Traits::scaledSum(v, v, { halfDt }, { a });
+			Traits::scaledSum(x, x, { dt }, { v });
+			accelerate(Traits::toConst(x), dt, a);
+			Traits::scaledSum(v, v, { halfDt }, { a });
+		});
+	}
+
+	///
+	/// \brief Drift-kick-drift leapfrog step of every (position, velocity) pair, see integrate::leapfrog()
+	/// and semiImplicitEuler() for the arguments.
+	///
+	template<typename S, typename States, typename AccelerationFunc, typename Chunks = SerialChunks>
+	void leapfrog(States positions, States velocities, S dt, AccelerationFunc accelerate,
+		Workspace<typename BatchTraits<States>::Value>& workspace, Chunks&& chunks = Chunks(), size_t chunkSize = DefaultChunkSize) {
+		using Traits = BatchTraits<States>;
+		workspace.k1.resize(Traits::storageSize(velocities));
+		const S halfDt = S(0.5) * dt;
+		forEachChunk(Traits::size(positions), chunks, chunkSize, [&](size_t begin, size_t size) {
+			const States x = Traits::slice(positions, begin, size);
+			const States v = Traits::slice(velocities, begin, size);
+			const States a = Traits::stage(workspace.k1, velocities, begin, size);
+			Traits::scaledSum(x, x, { halfDt }, { v });
+			accelerate(Traits::toConst(x), halfDt, a);
+			Traits::scaledSum(v, v, { dt }, { a });
+			Traits::scaledSum(x, x, { halfDt }, { v });
+		});
+	}
+}
 
@@ -0,0 +1,69 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Axis aligned bounding box given by its min and max corners.
+	///
+	struct AABB {
+		glm::vec2 min;
+		glm::vec2 max;
+	};
+
+	///
+	/// \brief Pair of overlapping proxies reported by a broadphase. Always a < b.
+	///
+	struct ProxyPair {
+		uint32_t a;
+		uint32_t b;
+	};
+
+	///
+	/// \brief Which proxies may collide: a pair is only reported when the category of each
+	/// proxy is in the mask of the other, so gameplay irrelevant pairs never reach the geometry tests.
+	///
+	struct CollisionFilter {
+		uint32_t category = 1;
+		uint32_t mask = ~0u;
+	};
+
+	inline bool shouldCollide(const CollisionFilter& a, const CollisionFilter& b) {
+		return (a.category & b.mask) != 0 && (b.category & a.mask) != 0;
+	}
+
+	// No filters at all means everything collides
+	inline bool shouldCollide(const std::vector<CollisionFilter>& filters, uint32_t a, uint32_t b) {
+		return filters.empty() || shouldCollide(filters[a], filters[b]);
+	}
+
+	inline bool overlaps(const AABB& a, const AABB& b) {
+		return a.min.x <= b.max.x && b.min.x <= a.max.x
+			&& a.min.y <= b.max.y && b.min.y <= a.max.y;
+	}
+
+	inline bool contains(const AABB& outer, const AABB& inner) {
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y
+			&& inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+	}
+
+	inline bool contains(const AABB& aabb, const glm::vec2& point) {
+		return aabb.min.x <= point.x && point.x <= aabb.max.x
+			&& aabb.min.y <= point.y && point.y <= aabb.max.y;
+	}
+
+	inline AABB combine(const AABB& a, const AABB& b) {
+		return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+	}
+
+	// Surface area heuristic cost of a box in 2D
+	inline float perimeter(const AABB& aabb) {
+		glm::vec2 d = aabb.max - aabb.min;
+		return 2.0f * (d.x + d.y);
+	}
+
+	inline AABB makeAABB(const glm::vec2& center, const glm::vec2& halfsize) {
+		return { center - halfsize, center + halfsize };
+	}
+}
@@ -0,0 +1,298 @@
+#include <physics2d/aabb_tree.h>
+#include <algorithm>
+#include <cfloat>
+
+namespace physics2d {
+	AABBTree::AABBTree(float margin)
+		: m_margin(margin) {
+	}
+
+	void AABBTree::clear() {
+		m_nodes.clear();
+		m_root = NullNode;
+		m_freeList = NullNode;
+	}
+
+	int32_t AABBTree::allocateNode() {
+		if (m_freeList == NullNode)
+		{
+			m_nodes.push_back(Node());
+			return int32_t(m_nodes.size()) - 1;
+		}
+		int32_t node = m_freeList;
+		m_freeList = m_nodes[node].parent;
+		m_nodes[node] = Node();
+		return node;
+	}
+
+	void AABBTree::freeNode(int32_t node) {
+		m_nodes[node].parent = m_freeList;
+		m_nodes[node].height = -1;
+		m_freeList = node;
+	}
+
+	int32_t AABBTree::createProxy(const AABB& aabb, uint32_t userData) {
+		int32_t proxy = allocateNode();
+		glm::vec2 margin(m_margin);
+		m_nodes[proxy].aabb = { aabb.min - margin, aabb.max + margin };
+		m_nodes[proxy].userData = userData;
+		m_nodes[proxy].height = 0;
+		insertLeaf(proxy);
+		return proxy;
+	}
+
+	void AABBTree::destroyProxy(int32_t proxy) {
+		removeLeaf(proxy);
+		freeNode(proxy);
+	}
+
+	bool AABBTree::moveProxy(int32_t proxy, const AABB& aabb, const glm::vec2& displacement) {
+		if (contains(m_nodes[proxy].aabb, aabb))
+		{
+			return false;
+		}
+
+		// Fatten by the margin and extend in the direction of movement, so a body
+		// moving steadily stays inside its leaf for a few more steps.
+		glm::vec2 margin(m_margin);
+		AABB fat = { aabb.min - margin, aabb.max + margin };
+		glm::vec2 d = 2.0f * displacement;
+		fat.min += glm::min(d, glm::vec2(0.0f));
+		fat.max += glm::max(d, glm::vec2(0.0f));
+
+		removeLeaf(proxy);
+		m_nodes[proxy].aabb = fat;
+		insertLeaf(proxy);
+		return true;
+	}
+
+	void AABBTree::insertLeaf(int32_t leaf) {
+		if (m_root == NullNode)
+		{
+			m_root = leaf;
+			m_nodes[leaf].parent = NullNode;
+			return;
+		}
+
+		// Find the best sibling by walking down where the perimeter grows the least
+		const AABB leafAABB = m_nodes[leaf].aabb;
+		int32_t index = m_root;
+		while (!m_nodes[index].isLeaf())
+		{
+			const Node& node = m_nodes[index];
+			float area = perimeter(node.aabb);
+			float combinedArea = perimeter(combine(node.aabb, leafAABB));
+
+			// Cost of making a new parent for this node and the new leaf
+			float cost = 2.0f * combinedArea;
+			// Minimum cost of pushing the leaf further down the tree
+			float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](int32_t child) {
+				const Node& c = m_nodes[child];
+				float grown = perimeter(combine(leafAABB, c.aabb));
+				return c.isLeaf() ? grown + inheritanceCost : grown - perimeter(c.aabb) + inheritanceCost;
+			};
+			float cost1 = childCost(node.child1);
+			float cost2 = childCost(node.child2);
+
+			if (cost < cost1 && cost < cost2)
+			{
+				break;
+			}
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+
+		int32_t sibling = index;
+		int32_t oldParent = m_nodes[sibling].parent;
+		int32_t newParent = allocateNode();
+		m_nodes[newParent].parent = oldParent;
+		m_nodes[newParent].aabb = combine(leafAABB, m_nodes[sibling].aabb);
+		m_nodes[newParent].height = m_nodes[sibling].height + 1;
+		m_nodes[newParent].child1 = sibling;
+		m_nodes[newParent].child2 = leaf;
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+
+		if (oldParent == NullNode)
+		{
+			m_root = newParent;
+		}
+		else if (m_nodes[oldParent].child1 == sibling)
+		{
+			m_nodes[oldParent].child1 = newParent;
+		}
+		else
+		{
+			m_nodes[oldParent].child2 = newParent;
+		}
+
+		refitAncestors(m_nodes[leaf].parent);
+	}
+
+	void AABBTree::removeLeaf(int32_t leaf) {
+		if (leaf == m_root)
+		{
+			m_root = NullNode;
+			return;
+		}
+
+		int32_t parent = m_nodes[leaf].parent;
+		int32_t grandParent = m_nodes[parent].parent;
+		int32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+		if (grandParent == NullNode)
+		{
+			m_root = sibling;
+			m_nodes[sibling].parent = NullNode;
+			freeNode(parent);
+			return;
+		}
+
+		// Replace the parent with the sibling
+		if (m_nodes[grandParent].child1 == parent)
+		{
+			m_nodes[grandParent].child1 = sibling;
+		}
+		else
+		{
+			m_nodes[grandParent].child2 = sibling;
+		}
+		m_nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		refitAncestors(grandParent);
+	}
+
+	void AABBTree::refitAncestors(int32_t index) {
+		while (index != NullNode)
+		{
+			index = balance(index);
+			Node& node = m_nodes[index];
+			node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+			node.aabb = combine(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+			index = node.parent;
+		}
+	}
+
+	// Rotates the taller child of node a up if the subtrees are out of balance.
+	// Returns the node that now sits where a was.
+	int32_t AABBTree::balance(int32_t ia) {
+		Node& a = m_nodes[ia];
+		if (a.isLeaf() || a.height < 2)
+		{
+			return ia;
+		}
+
+		int32_t ib = a.child1;
+		int32_t ic = a.child2;
+		int32_t diff = m_nodes[ic].height - m_nodes[ib].height;
+		if (diff >= -1 && diff <= 1)
+		{
+			return ia;
+		}
+
+		// Child that is rotated up and the sibling that stays below a
+		int32_t iup = diff > 1 ? ic : ib;
+		int32_t iother = diff > 1 ? ib : ic;
+		Node& up = m_nodes[iup];
+		int32_t i1 = up.child1;
+		int32_t i2 = up.child2;
+
+		// up takes a's place
+		up.child1 = ia;
+		up.parent = a.parent;
+		a.parent = iup;
+		if (up.parent == NullNode)
+		{
+			m_root = iup;
+		}
+		else if (m_nodes[up.parent].child1 == ia)
+		{
+			m_nodes[up.parent].child1 = iup;
+		}
+		else
+		{
+			m_nodes[up.parent].child2 = iup;
+		}
+
+		// The taller grandchild stays with up, the shorter one moves under a
+		int32_t keep = m_nodes[i1].height > m_nodes[i2].height ? i1 : i2;
+		int32_t move = keep == i1 ? i2 : i1;
+		up.child2 = keep;
+		if (diff > 1)
+		{
+			a.child2 = move;
+		}
+		else
+		{
+			a.child1 = move;
+		}
+		m_nodes[move].parent = ia;
+
+		a.aabb = combine(m_nodes[iother].aabb, m_nodes[move].aabb);
+		a.height = 1 + std::max(m_nodes[iother].height, m_nodes[move].height);
+		up.aabb = combine(a.aabb, m_nodes[keep].aabb);
+		up.height = 1 + std::max(a.height, m_nodes[keep].height);
+		return iup;
+	}
+
+	std::vector<int32_t> AABBTree::build(const std::vector<AABB>& bounds, const std::vector<uint32_t>& userData) {
+		clear();
+		if (bounds.empty())
+		{
+			return {};
+		}
+
+		std::vector<int32_t> leaves;
+		leaves.reserve(bounds.size());
+		glm::vec2 margin(m_margin);
+		for (uint32_t i = 0; i < uint32_t(bounds.size()); ++i)
+		{
+			int32_t leaf = allocateNode();
+			m_nodes[leaf].aabb = { bounds[i].min - margin, bounds[i].max + margin };
+			m_nodes[leaf].userData = userData[i];
+			leaves.push_back(leaf);
+		}
+		// buildRange() reorders its input, so keep the leaves in bounds order for the caller
+		std::vector<int32_t> order = leaves;
+		m_root = buildRange(order, 0, order.size());
+		m_nodes[m_root].parent = NullNode;
+		return leaves;
+	}
+
+	// Median split along the longest axis of the range's centers
+	int32_t AABBTree::buildRange(std::vector<int32_t>& leaves, size_t begin, size_t end) {
+		if (end - begin == 1)
+		{
+			return leaves[begin];
+		}
+
+		AABB centers = { glm::vec2(FLT_MAX), glm::vec2(-FLT_MAX) };
+		for (size_t i = begin; i < end; ++i)
+		{
+			const AABB& aabb = m_nodes[leaves[i]].aabb;
+			glm::vec2 c = 0.5f * (aabb.min + aabb.max);
+			centers = combine(centers, { c, c });
+		}
+		glm::vec2 extent = centers.max - centers.min;
+		int axis = extent.x >= extent.y ? 0 : 1;
+
+		size_t mid = begin + (end - begin) / 2;
+		std::nth_element(leaves.begin() + begin, leaves.begin() + mid, leaves.begin() + end, [&](int32_t l, int32_t r) {
+			return m_nodes[l].aabb.min[axis] + m_nodes[l].aabb.max[axis] < m_nodes[r].aabb.min[axis] + m_nodes[r].aabb.max[axis];
+		});
+
+		int32_t child1 = buildRange(leaves, begin, mid);
+		int32_t child2 = buildRange(leaves, mid, end);
+		int32_t parent = allocateNode();
+		Node& node = m_nodes[parent];
+		node.child1 = child1;
+		node.child2 = child2;
+		node.aabb = combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+		node.height = 1 + std::max(m_nodes[child1].height, m_nodes[child2].height);
+		m_nodes[child1].parent = parent;
+		m_nodes[child2].parent = parent;
+		return parent;
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <physics2d/aabb.h>
+#include <physics2d/memory_usage.h>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Dynamic bounding volume tree of AABBs.
+	///
+	/// Leaves store a fattened AABB, so a body can move a little without touching
+	/// the tree. Only when it leaves its fat AABB it is removed and reinserted.
+	/// Insertion picks the sibling with the smallest perimeter growth and keeps
+	/// the tree balanced with rotations.
+	///
+	class AABBTree {
+	public:
+		static constexpr int32_t NullNode = -1;
+
+		///
+		/// \brief margin = How much leaf AABBs are fattened on each side.
+		///
+		explicit AABBTree(float margin = 0.1f);
+
+		void clear();
+
+		///
+		/// \brief Inserts a leaf and returns its node id.
+		/// \param aabb = Tight bounds of the body.
+		/// \param userData = Value handed back from queries, usually the proxy id.
+		///
+		int32_t createProxy(const AABB& aabb, uint32_t userData);
+		void destroyProxy(int32_t proxy);
+
+		///
+		/// \brief Refits a leaf after its body moved.
+		/// \param displacement = Movement of the body this step, used to predict the fat AABB.
+		/// \return true if the leaf left its fat AABB and was reinserted.
+		///
+		bool moveProxy(int32_t proxy, const AABB& aabb, const glm::vec2& displacement);
+
+		///
+		/// \brief Builds a tree top-down from scratch. Leaf i gets userData[i].
+		/// Meant for bodies that never move, it gives a better tree than inserting one by one.
+		/// \return Leaf node of every bounds, usable with destroyProxy() and moveProxy().
+		///
+		std::vector<int32_t> build(const std::vector<AABB>& bounds, const std::vector<uint32_t>& userData);
+
+		const AABB& getFatAABB(int32_t proxy) const { return m_nodes[proxy].aabb; }
+		uint32_t getUserData(int32_t proxy) const { return m_nodes[proxy].userData; }
+		int32_t getHeight() const { return m_root == NullNode ? 0 : m_nodes[m_root].height; }
+		size_t getMemoryUsage() const { return physics2d::getMemoryUsage(m_nodes, m_stack, m_pairStack); }
+
+		///
+		/// \brief Calls callback(userData) for every leaf whose fat AABB overlaps aabb.
+		/// Returning false from the callback stops the query.
+		///
+		template<typename Callback>
+		void query(const AABB& aabb, Callback callback) const;
+
+		///
+		/// \brief Calls callback(userData) for every leaf whose fat AABB contains point.
+		///
+		template<typename Callback>
+		void queryPoint(const glm::vec2& point, Callback callback) const;
+
+		///
+		/// \brief Calls callback(userDataA, userDataB) once for every pair of leaves with overlapping fat AABBs.
+		///
+		template<typename Callback>
+		void queryPairs(Callback callback) const;
+
+	private:
+		struct Node {
+			AABB aabb;
+			int32_t parent = NullNode; // Next free node when on the free list
+			int32_t child1 = NullNode;
+			int32_t child2 = NullNode;
+			int32_t height = 0; // Leaf = 0, free node = -1
+			uint32_t userData = 0;
+
+			bool isLeaf() const { return child1 == NullNode; }
+		};
+
+		int32_t allocateNode();
+		void freeNode(int32_t node);
+		void insertLeaf(int32_t leaf);
+		void removeLeaf(int32_t leaf);
+		void refitAncestors(int32_t node);
+		int32_t balance(int32_t node);
+		int32_t buildRange(std::vector<int32_t>& leaves, size_t begin, size_t end);
+
+		float m_margin;
+		int32_t m_root = NullNode;
+		int32_t m_freeList = NullNode;
+		std::vector<Node> m_nodes;
+		mutable std::vector<int32_t> m_stack;
+		mutable std::vector<std::pair<int32_t, int32_t>> m_pairStack;
+	};
+
+	template<typename Callback>
+	void AABBTree::query(const AABB& aabb, Callback callback) const {
+		if (m_root == NullNode)
+		{
+			return;
+		}
+		m_stack.clear();
+		m_stack.push_back(m_root);
+		while (!m_stack.empty())
+		{
+			const Node& node = m_nodes[m_stack.back()];
+			m_stack.pop_back();
+			if (!overlaps(node.aabb, aabb))
+			{
+				continue;
+			}
+			if (node.isLeaf())
+			{
+				if (!callback(node.userData))
+				{
+					return;
+				}
+			}
+			else
+			{
+				m_stack.push_back(node.child1);
+				m_stack.push_back(node.child2);
+			}
+		}
+	}
+
+	template<typename Callback>
+	void AABBTree::queryPoint(const glm::vec2& point, Callback callback) const {
+		query({ point, point }, callback);
+	}
+
+	template<typename Callback>
+	void AABBTree::queryPairs(Callback callback) const {
+		if (m_root == NullNode)
+		{
+			return;
+		}
+		// Simultaneous descent of the tree against itself. A node paired with itself
+		// expands to its children paired with themselves and with each other.
+		m_pairStack.clear();
+		m_pairStack.push_back({ m_root, m_root });
+		while (!m_pairStack.empty())
+		{
+			auto [ia, ib] = m_pairStack.back();
+			m_pairStack.pop_back();
+			const Node& a = m_nodes[ia];
+			const Node& b = m_nodes[ib];
+
+			if (ia == ib)
+			{
+				if (!a.isLeaf())
+				{
+					m_pairStack.push_back({ a.child1, a.child1 });
+					m_pairStack.push_back({ a.child2, a.child2 });
+					m_pairStack.push_back({ a.child1, a.child2 });
+				}
+				continue;
+			}
+
+			if (!overlaps(a.aabb, b.aabb))
+			{
+				continue;
+			}
+
+			if (a.isLeaf() && b.isLeaf())
+			{
+				callback(a.userData, b.userData);
+			}
+			else if (b.isLeaf() || (!a.isLeaf() && a.height >= b.height))
+			{
+				m_pairStack.push_back({ a.child1, ib });
+				m_pairStack.push_back({ a.child2, ib });
+			}
+			else
+			{
+				m_pairStack.push_back({ ia, b.child1 });
+				m_pairStack.push_back({ ia, b.child2 });
+			}
+		}
+	}
+}
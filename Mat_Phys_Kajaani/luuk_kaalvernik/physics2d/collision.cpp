@@ -0,0 +1,567 @@
+#include <physics2d/collision.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace physics2d {
+	bool isAABBCollision(const Box& a, const Box& b, glm::vec2& normalVec) {
+		glm::vec2 d = b.position - a.position;
+		glm::vec2 hs = b.halfsize + a.halfsize;
+		bool x = std::abs(d.x) < hs.x;
+		bool y = std::abs(d.y) < hs.y;
+
+		if (x && y)
+		{
+			float overlapX = hs.x - std::abs(d.x);
+			float overlapY = hs.y - std::abs(d.y);
+			// normalVec = glm::normalize(-d);
+			if (overlapX > overlapY)
+			{
+				normalVec.y = overlapY;
+				normalVec.x = 0;
+				normalVec = glm::normalize(normalVec);
+			} else
+			{
+				normalVec.y = 0;
+				normalVec.x = overlapX;
+				normalVec = glm::normalize(normalVec);
+			}
+			return true;
+		}
+
+		return false;
+	}
+
+	bool isSphereSphereCollision(const Sphere& a, const Sphere& b, glm::vec2& normalVec) {
+		float d = glm::length(b.position - a.position);
+		float rTot = b.radius + a.radius;
+
+		if (d < rTot) {
+			normalVec = glm::normalize(a.position - b.position);
+
+			return true;
+		}
+
+		return false;
+
+	}
+
+	bool isSphereAABBCollision(const Sphere& sphere, const Box& b, glm::vec2& normalVec) {
+		float depth;
+		return sphereBoxContact(sphere, b, normalVec, depth);
+	}
+
+	bool sphereBoxContact(const Sphere& sphere, const Box& box, glm::vec2& normalVec, float& depth) {
+		// Sphere center in the local space of the box
+		float c = std::cos(box.rotation);
+		float s = std::sin(box.rotation);
+		glm::vec2 d = sphere.position - box.position;
+		glm::vec2 local(c * d.x + s * d.y, -s * d.x + c * d.y);
+
+		glm::vec2 closest = glm::clamp(local, -box.halfsize, box.halfsize);
+		glm::vec2 diff = local - closest;
+		float dist2 = glm::dot(diff, diff);
+		glm::vec2 localNormal;
+
+		if (dist2 > 0.0f)
+		{
+			// Center outside the box: normal from the closest point on the box to the center
+			if (dist2 >= sphere.radius * sphere.radius)
+			{
+				return false;
+			}
+			float dist = std::sqrt(dist2);
+			localNormal = diff / dist;
+			depth = sphere.radius - dist;
+		}
+		else
+		{
+			// Center inside the box: push out through the nearest face
+			glm::vec2 faceDistance = box.halfsize - glm::abs(local);
+			if (faceDistance.x < faceDistance.y)
+			{
+				localNormal = glm::vec2(local.x < 0.0f ? -1.0f : 1.0f, 0.0f);
+				depth = faceDistance.x + sphere.radius;
+			}
+			else
+			{
+				localNormal = glm::vec2(0.0f, local.y < 0.0f ? -1.0f : 1.0f);
+				depth = faceDistance.y + sphere.radius;
+			}
+		}
+
+		normalVec = glm::vec2(c * localNormal.x - s * localNormal.y, s * localNormal.x + c * localNormal.y);
+		return true;
+	}
+
+	// Fast path of collideBoxes() for two boxes without rotation
+	static bool collideAlignedBoxes(const Box& a, const Box& b, float margin, Contact& contact) {
+		glm::vec2 d = b.position - a.position;
+		glm::vec2 overlap = (a.halfsize + b.halfsize) - glm::abs(d);
+
+		// Separate along the axis of least overlap. The points are the ends of the
+		// overlapping part of the touching faces, placed on the face of b.
+		const int axis = overlap.x < overlap.y ? 0 : 1;
+		const int side = 1 - axis;
+		if (overlap[axis] <= -margin || overlap[side] <= 0.0f)
+		{
+			return false;
+		}
+		const float sign = d[axis] < 0.0f ? -1.0f : 1.0f;
+		contact.normal = glm::vec2(0.0f);
+		contact.normal[axis] = sign;
+
+		float face = b.position[axis] - sign * b.halfsize[axis];
+		float lo = std::max(a.position[side] - a.halfsize[side], b.position[side] - b.halfsize[side]);
+		float hi = std::min(a.position[side] + a.halfsize[side], b.position[side] + b.halfsize[side]);
+		const uint32_t feature = uint32_t(axis) << 2 | (sign < 0.0f ? 2u : 0u);
+		contact.pointCount = 2;
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			ContactPoint& point = contact.points[i];
+			point.position[axis] = face;
+			point.position[side] = i == 0 ? lo : hi;
+			point.depth = overlap[axis];
+			point.id = feature | i;
+		}
+		return true;
+	}
+
+	// A box in world space. Face i has the outward normal getFaceNormal(i) and runs from corner i to corner i + 1.
+	struct OrientedBox {
+		glm::vec2 center;
+		glm::vec2 axisX;
+		glm::vec2 axisY;
+		glm::vec2 halfsize;
+
+		glm::vec2 getFaceNormal(uint32_t face) const {
+			glm::vec2 normal = face % 2 == 0 ? axisX : axisY;
+			return face < 2 ? normal : -normal;
+		}
+
+		glm::vec2 getCorner(uint32_t corner) const {
+			static const float signX[4] = { 1, 1, -1, -1 };
+			static const float signY[4] = { -1, 1, 1, -1 };
+			return center + signX[corner % 4] * halfsize.x * axisX + signY[corner % 4] * halfsize.y * axisY;
+		}
+	};
+
+	static OrientedBox makeOrientedBox(const Box& box) {
+		const float c = std::cos(box.rotation);
+		const float s = std::sin(box.rotation);
+		return { box.position, { c, s }, { -s, c }, box.halfsize };
+	}
+
+	// Overlap of the projections of a and b on the face normals of both: axisX of a, axisY of a, axisX of b, axisY of b
+	static void projectOverlaps(const OrientedBox& a, const OrientedBox& b, float overlap[4]) {
+		const glm::vec2 d = b.center - a.center;
+#if defined(__SSE2__) || defined(_M_X64)
+		// One axis per lane, so all four projections take the same few instructions
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		const __m128 axisX = _mm_setr_ps(a.axisX.x, a.axisY.x, b.axisX.x, b.axisY.x);
+		const __m128 axisY = _mm_setr_ps(a.axisX.y, a.axisY.y, b.axisX.y, b.axisY.y);
+		auto absDot = [&](const glm::vec2& v) {
+			__m128 dot = _mm_add_ps(_mm_mul_ps(axisX, _mm_set1_ps(v.x)), _mm_mul_ps(axisY, _mm_set1_ps(v.y)));
+			return _mm_andnot_ps(signBit, dot);
+		};
+		__m128 radiusA = _mm_add_ps(_mm_mul_ps(absDot(a.axisX), _mm_set1_ps(a.halfsize.x)), _mm_mul_ps(absDot(a.axisY), _mm_set1_ps(a.halfsize.y)));
+		__m128 radiusB = _mm_add_ps(_mm_mul_ps(absDot(b.axisX), _mm_set1_ps(b.halfsize.x)), _mm_mul_ps(absDot(b.axisY), _mm_set1_ps(b.halfsize.y)));
+		_mm_storeu_ps(overlap, _mm_sub_ps(_mm_add_ps(radiusA, radiusB), absDot(d)));
+#else
+		const glm::vec2 axes[4] = { a.axisX, a.axisY, b.axisX, b.axisY };
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			float radiusA = a.halfsize.x * std::abs(glm::dot(axes[i], a.axisX)) + a.halfsize.y * std::abs(glm::dot(axes[i], a.axisY));
+			float radiusB = b.halfsize.x * std::abs(glm::dot(axes[i], b.axisX)) + b.halfsize.y * std::abs(glm::dot(axes[i], b.axisY));
+			overlap[i] = radiusA + radiusB - std::abs(glm::dot(axes[i], d));
+		}
+#endif
+	}
+
+	// Keeps the part of the first count points where dot(normal, p) <= offset. Two points are a segment,
+	// one point is kept or dropped. A point exactly on the plane is kept without adding a copy of it.
+	static uint32_t clipSegment(glm::vec2 points[2], uint32_t ids[2], uint32_t count, const glm::vec2& normal, float offset, uint32_t clipId) {
+		const float distance0 = glm::dot(normal, points[0]) - offset;
+		const float distance1 = count == 2 ? glm::dot(normal, points[1]) - offset : 0.0f;
+		glm::vec2 kept[2];
+		uint32_t keptIds[2];
+		uint32_t keptCount = 0;
+		if (count > 0 && distance0 <= 0.0f)
+		{
+			kept[keptCount] = points[0];
+			keptIds[keptCount++] = ids[0];
+		}
+		if (count == 2 && distance1 <= 0.0f)
+		{
+			kept[keptCount] = points[1];
+			keptIds[keptCount++] = ids[1];
+		}
+		if (count == 2 && distance0 * distance1 < 0.0f)
+		{
+			kept[keptCount] = points[0] + (distance0 / (distance0 - distance1)) * (points[1] - points[0]);
+			keptIds[keptCount++] = clipId;
+		}
+		for (uint32_t i = 0; i < keptCount; ++i)
+		{
+			points[i] = kept[i];
+			ids[i] = keptIds[i];
+		}
+		return keptCount;
+	}
+
+	// Separating axis test of two rotated boxes, with points from clipping the incident face against the reference face
+	static bool collideOrientedBoxes(const Box& boxA, const Box& boxB, float margin, Contact& contact) {
+		const OrientedBox a = makeOrientedBox(boxA);
+		const OrientedBox b = makeOrientedBox(boxB);
+		float overlap[4];
+		projectOverlaps(a, b, overlap);
+		if (overlap[0] <= -margin || overlap[1] <= -margin || overlap[2] <= -margin || overlap[3] <= -margin)
+		{
+			return false;
+		}
+
+		// The face of a wins ties, so the reference face does not flip between steps for nearly equal overlaps
+		const uint32_t axisA = overlap[0] <= overlap[1] ? 0 : 1;
+		const uint32_t axisB = overlap[2] <= overlap[3] ? 2 : 3;
+		const bool flip = overlap[axisB] + 0.0005f < 0.98f * overlap[axisA];
+		const OrientedBox& reference = flip ? b : a;
+		const OrientedBox& incident = flip ? a : b;
+		const uint32_t axis = flip ? axisB - 2 : axisA;
+
+		glm::vec2 normal = axis == 0 ? reference.axisX : reference.axisY;
+		const bool negative = glm::dot(normal, incident.center - reference.center) < 0.0f;
+		const uint32_t referenceFace = axis + (negative ? 2 : 0);
+		normal = reference.getFaceNormal(referenceFace);
+
+		// The incident face is the one facing most against the reference normal
+		uint32_t incidentFace = 0;
+		float lowest = FLT_MAX;
+		for (uint32_t face = 0; face < 4; ++face)
+		{
+			float facing = glm::dot(normal, incident.getFaceNormal(face));
+			if (facing < lowest)
+			{
+				lowest = facing;
+				incidentFace = face;
+			}
+		}
+
+		// Clip the incident face to the sides of the reference face
+		const glm::vec2 start = reference.getCorner(referenceFace);
+		const glm::vec2 end = reference.getCorner(referenceFace + 1);
+		const glm::vec2 tangent = glm::normalize(end - start);
+		glm::vec2 points[2] = { incident.getCorner(incidentFace), incident.getCorner(incidentFace + 1) };
+		uint32_t ids[2] = { incidentFace, (incidentFace + 1) % 4 };
+		// A corner exactly on a side plane survives alone, it still makes a contact of one point
+		uint32_t count = clipSegment(points, ids, 2, -tangent, -glm::dot(tangent, start), 4);
+		count = clipSegment(points, ids, count, tangent, glm::dot(tangent, end), 5);
+		if (count == 0)
+		{
+			return false;
+		}
+
+		// Normal points from a to b, whichever box the reference face belongs to
+		contact.normal = flip ? -normal : normal;
+		contact.pointCount = 0;
+		const float faceOffset = glm::dot(normal, start);
+		const uint32_t feature = (flip ? 1u : 0u) << 7 | referenceFace << 5 | incidentFace << 3;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float depth = faceOffset - glm::dot(normal, points[i]);
+			if (depth <= -margin)
+			{
+				continue;
+			}
+			ContactPoint& point = contact.points[contact.pointCount++];
+			point.position = points[i];
+			point.depth = depth;
+			point.id = feature | ids[i];
+		}
+		return contact.pointCount > 0;
+	}
+
+	bool collideBoxes(const Box& a, const Box& b, float margin, Contact& contact) {
+		if (a.rotation == 0.0f && b.rotation == 0.0f)
+		{
+			return collideAlignedBoxes(a, b, margin, contact);
+		}
+		return collideOrientedBoxes(a, b, margin, contact);
+	}
+
+	bool collideSpheres(const Sphere& a, const Sphere& b, float margin, Contact& contact) {
+		glm::vec2 d = b.position - a.position;
+		float dist2 = glm::dot(d, d);
+		float rTot = a.radius + b.radius;
+		if (dist2 >= (rTot + margin) * (rTot + margin))
+		{
+			return false;
+		}
+
+		float dist = std::sqrt(dist2);
+		contact.normal = dist > 0.0f ? d / dist : glm::vec2(0.0f, 1.0f);
+		contact.pointCount = 1;
+		contact.points[0].position = b.position - contact.normal * b.radius;
+		contact.points[0].depth = rTot - dist;
+		contact.points[0].id = 0;
+		return true;
+	}
+
+	bool collideBoxSphere(const Box& a, const Sphere& b, float margin, Contact& contact) {
+		// A sphere grown by the margin touches the box when the real one is within the margin
+		Sphere grown = b;
+		grown.radius += margin;
+		float depth;
+		if (!sphereBoxContact(grown, a, contact.normal, depth))
+		{
+			return false;
+		}
+		contact.pointCount = 1;
+		contact.points[0].position = b.position - contact.normal * b.radius;
+		contact.points[0].depth = depth - margin;
+		contact.points[0].id = 0;
+		return true;
+	}
+
+	// Entry time in [0, 1] of the segment origin + t * direction into aabb, false if it starts inside or misses
+	static bool rayAABB(const glm::vec2& origin, const glm::vec2& direction, const AABB& aabb, float& t) {
+		float enter = 0.0f;
+		float exit = 1.0f;
+		bool inside = true;
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			const float low = aabb.min[axis] - origin[axis];
+			const float high = aabb.max[axis] - origin[axis];
+			inside = inside && low < 0.0f && high > 0.0f;
+			if (direction[axis] == 0.0f)
+			{
+				if (low > 0.0f || high < 0.0f)
+				{
+					return false;
+				}
+				continue;
+			}
+			const float inverse = 1.0f / direction[axis];
+			float near = low * inverse;
+			float far = high * inverse;
+			if (near > far)
+			{
+				std::swap(near, far);
+			}
+			enter = std::max(enter, near);
+			exit = std::min(exit, far);
+		}
+		t = enter;
+		return !inside && enter <= exit;
+	}
+
+	// Entry time in [0, 1] of the segment origin + t * direction into the circle, false if it starts inside or misses
+	static bool rayCircle(const glm::vec2& origin, const glm::vec2& direction, const glm::vec2& center, float radius, float& t) {
+		const glm::vec2 d = origin - center;
+		const float c = glm::dot(d, d) - radius * radius;
+		const float b = glm::dot(d, direction);
+		const float a = glm::dot(direction, direction);
+		if (c <= 0.0f || b >= 0.0f || a == 0.0f)
+		{
+			return false;
+		}
+		const float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+		t = (-b - std::sqrt(discriminant)) / a;
+		return t <= 1.0f;
+	}
+
+	bool sweepAABB(const AABB& moving, const glm::vec2& displacement, const AABB& target, float& toi) {
+		// The center of moving against target grown by the half size of moving
+		const glm::vec2 halfsize = 0.5f * (moving.max - moving.min);
+		const glm::vec2 center = 0.5f * (moving.min + moving.max);
+		return rayAABB(center, displacement, { target.min - halfsize, target.max + halfsize }, toi);
+	}
+
+	bool sweepCircles(const glm::vec2& center, float radius, const glm::vec2& displacement, const glm::vec2& targetCenter, float targetRadius, float& toi) {
+		return rayCircle(center, displacement, targetCenter, radius + targetRadius, toi);
+	}
+
+	bool sweepCircleAABB(const glm::vec2& center, float radius, const glm::vec2& displacement, const AABB& target, float& toi) {
+		// Target grown by radius is a rounded box: two crossing rectangles and a circle on every corner
+		const glm::vec2 closest = glm::clamp(center, target.min, target.max);
+		if (glm::dot(center - closest, center - closest) <= radius * radius)
+		{
+			return false;
+		}
+
+		bool hit = false;
+		toi = 1.0f;
+		float t;
+		if (rayAABB(center, displacement, { target.min - glm::vec2(radius, 0), target.max + glm::vec2(radius, 0) }, t) && t <= toi)
+		{
+			toi = t;
+			hit = true;
+		}
+		if (rayAABB(center, displacement, { target.min - glm::vec2(0, radius), target.max + glm::vec2(0, radius) }, t) && t <= toi)
+		{
+			toi = t;
+			hit = true;
+		}
+		const glm::vec2 corners[4] = { target.min, { target.max.x, target.min.y }, target.max, { target.min.x, target.max.y } };
+		for (const auto& corner : corners)
+		{
+			if (rayCircle(center, displacement, corner, radius, t) && t <= toi)
+			{
+				toi = t;
+				hit = true;
+			}
+		}
+		return hit;
+	}
+
+	BoxBatch makeBoxBatch(const Box* boxes, uint32_t count) {
+		BoxBatch batch;
+		batch.count = count;
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			// Unused lanes get an empty box, their results are masked out anyway
+			const bool used = i < count;
+			batch.centerX[i] = used ? boxes[i].position.x : 0.0f;
+			batch.centerY[i] = used ? boxes[i].position.y : 0.0f;
+			batch.halfsizeX[i] = used ? boxes[i].halfsize.x : 0.0f;
+			batch.halfsizeY[i] = used ? boxes[i].halfsize.y : 0.0f;
+			batch.cosRotation[i] = used ? std::cos(boxes[i].rotation) : 1.0f;
+			batch.sinRotation[i] = used ? std::sin(boxes[i].rotation) : 0.0f;
+		}
+		return batch;
+	}
+
+#if defined(__AVX__)
+	uint32_t sphereBoxContacts(const Sphere& sphere, const BoxBatch& boxes, float normalX[8], float normalY[8], float depth[8]) {
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 signBit = _mm256_set1_ps(-0.0f);
+		const __m256 radius = _mm256_set1_ps(sphere.radius);
+		const __m256 c = _mm256_load_ps(boxes.cosRotation);
+		const __m256 s = _mm256_load_ps(boxes.sinRotation);
+		const __m256 hx = _mm256_load_ps(boxes.halfsizeX);
+		const __m256 hy = _mm256_load_ps(boxes.halfsizeY);
+
+		// Sphere center in the local space of each box
+		__m256 dx = _mm256_sub_ps(_mm256_set1_ps(sphere.position.x), _mm256_load_ps(boxes.centerX));
+		__m256 dy = _mm256_sub_ps(_mm256_set1_ps(sphere.position.y), _mm256_load_ps(boxes.centerY));
+		__m256 lx = _mm256_add_ps(_mm256_mul_ps(c, dx), _mm256_mul_ps(s, dy));
+		__m256 ly = _mm256_sub_ps(_mm256_mul_ps(c, dy), _mm256_mul_ps(s, dx));
+
+		// Closest point on the box and distance to it
+		__m256 ex = _mm256_sub_ps(lx, _mm256_min_ps(_mm256_max_ps(lx, _mm256_xor_ps(hx, signBit)), hx));
+		__m256 ey = _mm256_sub_ps(ly, _mm256_min_ps(_mm256_max_ps(ly, _mm256_xor_ps(hy, signBit)), hy));
+		__m256 dist2 = _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey));
+		__m256 outside = _mm256_cmp_ps(dist2, zero, _CMP_GT_OQ);
+		__m256 dist = _mm256_sqrt_ps(dist2);
+		__m256 invDist = _mm256_div_ps(one, _mm256_blendv_ps(one, dist, outside));
+
+		// Center inside: nearest face
+		__m256 fx = _mm256_sub_ps(hx, _mm256_andnot_ps(signBit, lx));
+		__m256 fy = _mm256_sub_ps(hy, _mm256_andnot_ps(signBit, ly));
+		__m256 useX = _mm256_cmp_ps(fx, fy, _CMP_LT_OQ);
+		__m256 signX = _mm256_or_ps(_mm256_and_ps(lx, signBit), one);
+		__m256 signY = _mm256_or_ps(_mm256_and_ps(ly, signBit), one);
+		__m256 inNx = _mm256_and_ps(useX, signX);
+		__m256 inNy = _mm256_andnot_ps(useX, signY);
+		__m256 inDepth = _mm256_add_ps(_mm256_min_ps(fx, fy), radius);
+
+		__m256 nx = _mm256_blendv_ps(inNx, _mm256_mul_ps(ex, invDist), outside);
+		__m256 ny = _mm256_blendv_ps(inNy, _mm256_mul_ps(ey, invDist), outside);
+		__m256 d = _mm256_blendv_ps(inDepth, _mm256_sub_ps(radius, dist), outside);
+		__m256 hit = _mm256_or_ps(_mm256_andnot_ps(outside, one), _mm256_cmp_ps(dist2, _mm256_mul_ps(radius, radius), _CMP_LT_OQ));
+		hit = _mm256_cmp_ps(hit, zero, _CMP_NEQ_UQ);
+
+		// Normals back to world space
+		_mm256_storeu_ps(normalX, _mm256_sub_ps(_mm256_mul_ps(c, nx), _mm256_mul_ps(s, ny)));
+		_mm256_storeu_ps(normalY, _mm256_add_ps(_mm256_mul_ps(s, nx), _mm256_mul_ps(c, ny)));
+		_mm256_storeu_ps(depth, d);
+		return uint32_t(_mm256_movemask_ps(hit)) & ((1u << boxes.count) - 1u);
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	// Four lanes of sphereBoxContacts() starting at lane
+	static uint32_t sphereBoxContacts4(const Sphere& sphere, const BoxBatch& boxes, uint32_t lane, float* normalX, float* normalY, float* depth) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		const __m128 radius = _mm_set1_ps(sphere.radius);
+		const __m128 c = _mm_load_ps(boxes.cosRotation + lane);
+		const __m128 s = _mm_load_ps(boxes.sinRotation + lane);
+		const __m128 hx = _mm_load_ps(boxes.halfsizeX + lane);
+		const __m128 hy = _mm_load_ps(boxes.halfsizeY + lane);
+		// SSE2 has no blendv, select with and/andnot/or
+		auto select = [](__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+			return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+		};
+
+		// Sphere center in the local space of each box
+		__m128 dx = _mm_sub_ps(_mm_set1_ps(sphere.position.x), _mm_load_ps(boxes.centerX + lane));
+		__m128 dy = _mm_sub_ps(_mm_set1_ps(sphere.position.y), _mm_load_ps(boxes.centerY + lane));
+		__m128 lx = _mm_add_ps(_mm_mul_ps(c, dx), _mm_mul_ps(s, dy));
+		__m128 ly = _mm_sub_ps(_mm_mul_ps(c, dy), _mm_mul_ps(s, dx));
+
+		// Closest point on the box and distance to it
+		__m128 ex = _mm_sub_ps(lx, _mm_min_ps(_mm_max_ps(lx, _mm_xor_ps(hx, signBit)), hx));
+		__m128 ey = _mm_sub_ps(ly, _mm_min_ps(_mm_max_ps(ly, _mm_xor_ps(hy, signBit)), hy));
+		__m128 dist2 = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+		__m128 outside = _mm_cmpgt_ps(dist2, zero);
+		__m128 dist = _mm_sqrt_ps(dist2);
+		__m128 invDist = _mm_div_ps(one, select(outside, dist, one));
+
+		// Center inside: nearest face
+		__m128 fx = _mm_sub_ps(hx, _mm_andnot_ps(signBit, lx));
+		__m128 fy = _mm_sub_ps(hy, _mm_andnot_ps(signBit, ly));
+		__m128 useX = _mm_cmplt_ps(fx, fy);
+		__m128 signX = _mm_or_ps(_mm_and_ps(lx, signBit), one);
+		__m128 signY = _mm_or_ps(_mm_and_ps(ly, signBit), one);
+		__m128 inNx = _mm_and_ps(useX, signX);
+		__m128 inNy = _mm_andnot_ps(useX, signY);
+		__m128 inDepth = _mm_add_ps(_mm_min_ps(fx, fy), radius);
+
+		__m128 nx = select(outside, _mm_mul_ps(ex, invDist), inNx);
+		__m128 ny = select(outside, _mm_mul_ps(ey, invDist), inNy);
+		__m128 d = select(outside, _mm_sub_ps(radius, dist), inDepth);
+		__m128 hit = _mm_or_ps(_mm_andnot_ps(outside, _mm_cmpeq_ps(zero, zero)), _mm_cmplt_ps(dist2, _mm_mul_ps(radius, radius)));
+
+		// Normals back to world space
+		_mm_storeu_ps(normalX, _mm_sub_ps(_mm_mul_ps(c, nx), _mm_mul_ps(s, ny)));
+		_mm_storeu_ps(normalY, _mm_add_ps(_mm_mul_ps(s, nx), _mm_mul_ps(c, ny)));
+		_mm_storeu_ps(depth, d);
+		return uint32_t(_mm_movemask_ps(hit));
+	}
+
+	uint32_t sphereBoxContacts(const Sphere& sphere, const BoxBatch& boxes, float normalX[8], float normalY[8], float depth[8]) {
+		uint32_t low = sphereBoxContacts4(sphere, boxes, 0, normalX, normalY, depth);
+		uint32_t high = sphereBoxContacts4(sphere, boxes, 4, normalX + 4, normalY + 4, depth + 4);
+		return (low | (high << 4)) & ((1u << boxes.count) - 1u);
+	}
+#else
+	uint32_t sphereBoxContacts(const Sphere& sphere, const BoxBatch& boxes, float normalX[8], float normalY[8], float depth[8]) {
+		uint32_t mask = 0;
+		for (uint32_t i = 0; i < boxes.count; ++i)
+		{
+			Box box;
+			box.position = { boxes.centerX[i], boxes.centerY[i] };
+			box.halfsize = { boxes.halfsizeX[i], boxes.halfsizeY[i] };
+			box.rotation = std::atan2(boxes.sinRotation[i], boxes.cosRotation[i]);
+			glm::vec2 normal;
+			if (sphereBoxContact(sphere, box, normal, depth[i]))
+			{
+				normalX[i] = normal.x;
+				normalY[i] = normal.y;
+				mask |= 1u << i;
+			}
+		}
+		return mask;
+	}
+#endif
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <physics2d/contact.h>
+#include <physics2d/shapes.h>
+
+namespace physics2d {
+	///
+	/// \brief Narrowphase tests. Return true and set normalVec when the shapes collide.
+	///
+	bool isAABBCollision(const Box& a, const Box& b, glm::vec2& normalVec);
+	bool isSphereSphereCollision(const Sphere& a, const Sphere& b, glm::vec2& normalVec);
+	bool isSphereAABBCollision(const Sphere& sphere, const Box& b, glm::vec2& normalVec);
+
+	///
+	/// \brief Closest point test between a sphere and a box, box rotation included.
+	/// \param normalVec = Unit contact normal pointing from the box towards the sphere.
+	/// \param depth = How deep the sphere penetrates the box along normalVec.
+	/// \return true if they overlap.
+	///
+	bool sphereBoxContact(const Sphere& sphere, const Box& box, glm::vec2& normalVec, float& depth);
+
+	///
+	/// \brief Contact manifolds for the solver. Fill in normal (pointing from a to b),
+	/// depth and points of contact, leaving contact.a and contact.b untouched.
+	/// Boxes are tested on the axes of both boxes, with a cheaper path when neither is rotated.
+	/// \param margin = Shapes closer than this get a contact with negative depth, so
+	/// the solver can stop them before they touch.
+	/// \return true if the shapes are closer than margin.
+	///
+	bool collideBoxes(const Box& a, const Box& b, float margin, Contact& contact);
+	bool collideSpheres(const Sphere& a, const Sphere& b, float margin, Contact& contact);
+	bool collideBoxSphere(const Box& a, const Sphere& b, float margin, Contact& contact);
+
+	///
+	/// \brief Time of impact tests for continuous collision detection. The first shape
+	/// moves by displacement while the second one stands still, so for two moving
+	/// shapes pass the displacement of the first relative to the second.
+	/// \param toi = Share of displacement in [0, 1] moved when the shapes first touch.
+	/// \return true if the shapes start apart and touch within displacement. Shapes that
+	/// already overlap are left to the contacts.
+	///
+	bool sweepAABB(const AABB& moving, const glm::vec2& displacement, const AABB& target, float& toi);
+	bool sweepCircles(const glm::vec2& center, float radius, const glm::vec2& displacement, const glm::vec2& targetCenter, float targetRadius, float& toi);
+	bool sweepCircleAABB(const glm::vec2& center, float radius, const glm::vec2& displacement, const AABB& target, float& toi);
+
+	///
+	/// \brief Up to 8 boxes stored component wise, one box per SIMD lane.
+	///
+	struct BoxBatch {
+		alignas(32) float centerX[8];
+		alignas(32) float centerY[8];
+		alignas(32) float halfsizeX[8];
+		alignas(32) float halfsizeY[8];
+		alignas(32) float cosRotation[8];
+		alignas(32) float sinRotation[8];
+		uint32_t count = 0;
+	};
+
+	///
+	/// \brief Fills a batch from count (at most 8) consecutive boxes.
+	///
+	BoxBatch makeBoxBatch(const Box* boxes, uint32_t count);
+
+	///
+	/// \brief sphereBoxContact() for one sphere against every box of the batch at once.
+	/// Normal and depth of lane i are only meaningful when bit i of the result is set.
+	/// \return Bit mask of the boxes the sphere overlaps.
+	///
+	uint32_t sphereBoxContacts(const Sphere& sphere, const BoxBatch& boxes, float normalX[8], float normalY[8], float depth[8]);
+}
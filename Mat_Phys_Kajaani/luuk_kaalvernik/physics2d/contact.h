@@ -0,0 +1,27 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace physics2d {
+	///
+	/// \brief One point of a contact manifold.
+	///
+	struct ContactPoint {
+		glm::vec2 position; // World space, on the surface of body b
+		float depth = 0.0f;
+		uint32_t id = 0; // Which features touch, used to find the same point next step
+		float normalImpulse = 0.0f; // Accumulated by the solver
+		float tangentImpulse = 0.0f;
+	};
+
+	///
+	/// \brief Result of a positive narrowphase test between proxies a and b.
+	///
+	struct Contact {
+		uint32_t a;
+		uint32_t b;
+		glm::vec2 normal; // Unit length, points from a towards b
+		uint32_t pointCount = 0;
+		ContactPoint points[2];
+	};
+}
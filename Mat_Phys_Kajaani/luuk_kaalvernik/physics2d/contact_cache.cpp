@@ -0,0 +1,82 @@
+#include <physics2d/contact_cache.h>
+
+namespace physics2d {
+	namespace {
+		uint32_t hashPair(uint32_t a, uint32_t b) {
+			uint64_t key = uint64_t(a) << 32 | b;
+			key *= 0x9E3779B97F4A7C15ull;
+			return uint32_t(key >> 32);
+		}
+	}
+
+	void ContactCache::warmStart(std::vector<Contact>& contacts) const {
+		if (m_contacts.empty())
+		{
+			return;
+		}
+		for (auto& contact : contacts)
+		{
+			uint32_t index = find(contact.a, contact.b);
+			if (index == Empty)
+			{
+				continue;
+			}
+			const Contact& old = m_contacts[index];
+			for (uint32_t i = 0; i < contact.pointCount; ++i)
+			{
+				ContactPoint& point = contact.points[i];
+				for (uint32_t j = 0; j < old.pointCount; ++j)
+				{
+					if (old.points[j].id == point.id)
+					{
+						point.normalImpulse = old.points[j].normalImpulse;
+						point.tangentImpulse = old.points[j].tangentImpulse;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	void ContactCache::store(const std::vector<Contact>& contacts) {
+		m_contacts = contacts;
+
+		// Power of two size at least twice the contact count keeps the probe chains short
+		uint32_t size = 16;
+		while (size < 2 * uint32_t(contacts.size()))
+		{
+			size *= 2;
+		}
+		m_tableMask = size - 1;
+		m_table.assign(size, Empty);
+		for (uint32_t i = 0; i < uint32_t(m_contacts.size()); ++i)
+		{
+			uint32_t slot = hashPair(m_contacts[i].a, m_contacts[i].b) & m_tableMask;
+			while (m_table[slot] != Empty)
+			{
+				slot = (slot + 1) & m_tableMask;
+			}
+			m_table[slot] = i;
+		}
+	}
+
+	void ContactCache::clear() {
+		m_contacts.clear();
+		m_table.clear();
+		m_tableMask = 0;
+	}
+
+	uint32_t ContactCache::find(uint32_t a, uint32_t b) const {
+		uint32_t slot = hashPair(a, b) & m_tableMask;
+		while (m_table[slot] != Empty)
+		{
+			const Contact& contact = m_contacts[m_table[slot]];
+			if (contact.a == a && contact.b == b)
+			{
+				return m_table[slot];
+			}
+			slot = (slot + 1) & m_tableMask;
+		}
+		return Empty;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <physics2d/contact.h>
+#include <physics2d/memory_usage.h>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Remembers the contact manifolds of the last step, keyed by body pair.
+	///
+	/// Points are matched by their feature id, so a point that persists between
+	/// steps starts with the impulses the solver ended with last step. Resting
+	/// contacts then need only a few solver iterations to converge.
+	///
+	class ContactCache {
+	public:
+		///
+		/// \brief Copies the accumulated impulses of matching points from the stored manifolds.
+		///
+		void warmStart(std::vector<Contact>& contacts) const;
+
+		///
+		/// \brief Replaces the stored manifolds with contacts, for warmStart() in the next step.
+		///
+		void store(const std::vector<Contact>& contacts);
+
+		void clear();
+		size_t getMemoryUsage() const { return physics2d::getMemoryUsage(m_contacts, m_table); }
+
+	private:
+		static constexpr uint32_t Empty = ~0u;
+
+		uint32_t find(uint32_t a, uint32_t b) const;
+
+		std::vector<Contact> m_contacts;
+		std::vector<uint32_t> m_table; // Open addressing hash table of indices into m_contacts
+		uint32_t m_tableMask = 0;
+	};
+}
@@ -0,0 +1,379 @@
+#include <physics2d/contact_solver.h>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace physics2d {
+	namespace {
+		// SimdWidth floats, one per contact of a block
+#if defined(__AVX__)
+		struct Wide {
+			__m256 v;
+			static Wide load(const float* p) { return { _mm256_load_ps(p) }; }
+			static Wide splat(float x) { return { _mm256_set1_ps(x) }; }
+			void store(float* p) const { _mm256_store_ps(p, v); }
+		};
+		inline Wide operator+(Wide a, Wide b) { return { _mm256_add_ps(a.v, b.v) }; }
+		inline Wide operator-(Wide a, Wide b) { return { _mm256_sub_ps(a.v, b.v) }; }
+		inline Wide operator*(Wide a, Wide b) { return { _mm256_mul_ps(a.v, b.v) }; }
+		inline Wide operator-(Wide a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+		inline Wide min(Wide a, Wide b) { return { _mm256_min_ps(a.v, b.v) }; }
+		inline Wide max(Wide a, Wide b) { return { _mm256_max_ps(a.v, b.v) }; }
+#elif defined(__SSE2__) || defined(_M_X64)
+		struct Wide {
+			__m128 v;
+			static Wide load(const float* p) { return { _mm_load_ps(p) }; }
+			static Wide splat(float x) { return { _mm_set1_ps(x) }; }
+			void store(float* p) const { _mm_store_ps(p, v); }
+		};
+		inline Wide operator+(Wide a, Wide b) { return { _mm_add_ps(a.v, b.v) }; }
+		inline Wide operator-(Wide a, Wide b) { return { _mm_sub_ps(a.v, b.v) }; }
+		inline Wide operator*(Wide a, Wide b) { return { _mm_mul_ps(a.v, b.v) }; }
+		inline Wide operator-(Wide a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+		inline Wide min(Wide a, Wide b) { return { _mm_min_ps(a.v, b.v) }; }
+		inline Wide max(Wide a, Wide b) { return { _mm_max_ps(a.v, b.v) }; }
+#else
+		struct Wide {
+			float v;
+			static Wide load(const float* p) { return { *p }; }
+			static Wide splat(float x) { return { x }; }
+			void store(float* p) const { *p = v; }
+		};
+		inline Wide operator+(Wide a, Wide b) { return { a.v + b.v }; }
+		inline Wide operator-(Wide a, Wide b) { return { a.v - b.v }; }
+		inline Wide operator*(Wide a, Wide b) { return { a.v * b.v }; }
+		inline Wide operator-(Wide a) { return { -a.v }; }
+		inline Wide min(Wide a, Wide b) { return { std::min(a.v, b.v) }; }
+		inline Wide max(Wide a, Wide b) { return { std::max(a.v, b.v) }; }
+#endif
+		inline Wide clamp(Wide x, Wide low, Wide high) { return min(max(x, low), high); }
+
+		constexpr uint32_t Width = ContactSolver::SimdWidth;
+		constexpr uint32_t NoContact = ~0u;
+
+		// A vec2 member of both bodies of every lane
+		struct WideBodies {
+			Wide ax, ay, bx, by;
+		};
+
+		template<typename Block>
+		WideBodies gather(const Block& block, const std::vector<SolverBody>& bodies, glm::vec2 SolverBody::* member) {
+			alignas(32) float ax[Width], ay[Width], bx[Width], by[Width];
+			for (uint32_t lane = 0; lane < Width; ++lane)
+			{
+				glm::vec2 a(0.0f), b(0.0f);
+				if (block.contact[lane] != NoContact)
+				{
+					a = bodies[block.bodyA[lane]].*member;
+					b = bodies[block.bodyB[lane]].*member;
+				}
+				ax[lane] = a.x;
+				ay[lane] = a.y;
+				bx[lane] = b.x;
+				by[lane] = b.y;
+			}
+			return { Wide::load(ax), Wide::load(ay), Wide::load(bx), Wide::load(by) };
+		}
+
+		// Static bodies are shared by blocks solved at the same time, so only moving bodies are written
+		template<typename Block>
+		void scatter(const Block& block, std::vector<SolverBody>& bodies, glm::vec2 SolverBody::* member, const WideBodies& values) {
+			alignas(32) float ax[Width], ay[Width], bx[Width], by[Width];
+			values.ax.store(ax);
+			values.ay.store(ay);
+			values.bx.store(bx);
+			values.by.store(by);
+			for (uint32_t lane = 0; lane < Width; ++lane)
+			{
+				if (block.inverseMassA[lane] > 0.0f)
+				{
+					bodies[block.bodyA[lane]].*member = glm::vec2(ax[lane], ay[lane]);
+				}
+				if (block.inverseMassB[lane] > 0.0f)
+				{
+					bodies[block.bodyB[lane]].*member = glm::vec2(bx[lane], by[lane]);
+				}
+			}
+		}
+
+		// Applies impulse (px, py) to both bodies of every lane
+		inline void applyImpulse(WideBodies& v, Wide inverseMassA, Wide inverseMassB, Wide px, Wide py) {
+			v.ax = v.ax - inverseMassA * px;
+			v.ay = v.ay - inverseMassA * py;
+			v.bx = v.bx + inverseMassB * px;
+			v.by = v.by + inverseMassB * py;
+		}
+	}
+
+	ContactSolver::ContactSolver(JobSystem& jobs)
+		: m_jobs(jobs) {
+	}
+
+	void ContactSolver::buildBlocks(const std::vector<Contact>& contacts, const std::vector<SolverBody>& bodies, const SolverSettings& settings, float deltaTime) {
+		// Greedy coloring in contact order: the first color none of the moving bodies has yet
+		const uint32_t overflow = MaxColors;
+		m_colorBodies.assign(bodies.size(), 0);
+		m_contactColor.resize(contacts.size());
+		uint32_t colorSize[MaxColors + 1] = {};
+		for (uint32_t c = 0; c < uint32_t(contacts.size()); ++c)
+		{
+			const Contact& contact = contacts[c];
+			const bool movesA = bodies[contact.a].inverseMass > 0.0f;
+			const bool movesB = bodies[contact.b].inverseMass > 0.0f;
+			if (!movesA && !movesB)
+			{
+				m_contactColor[c] = NoContact;
+				continue;
+			}
+
+			uint32_t used = (movesA ? m_colorBodies[contact.a] : 0) | (movesB ? m_colorBodies[contact.b] : 0);
+			uint32_t color = 0;
+			while (color < MaxColors && (used & (1u << color)) != 0)
+			{
+				++color;
+			}
+			if (color < MaxColors)
+			{
+				if (movesA) m_colorBodies[contact.a] |= 1u << color;
+				if (movesB) m_colorBodies[contact.b] |= 1u << color;
+			}
+			m_contactColor[c] = color;
+			++colorSize[color];
+		}
+
+		// Blocks of a color are consecutive. Overflow contacts share bodies, so they get a block each.
+		m_colorStart.assign(1, 0);
+		for (uint32_t color = 0; color <= overflow; ++color)
+		{
+			uint32_t blocks = color == overflow ? colorSize[color] : (colorSize[color] + Width - 1) / Width;
+			m_colorStart.push_back(m_colorStart.back() + blocks);
+		}
+		m_colorCount = 0;
+		for (uint32_t color = 0; color < MaxColors; ++color)
+		{
+			m_colorCount += colorSize[color] > 0;
+		}
+
+		m_blocks.resize(m_colorStart.back());
+		for (auto& block : m_blocks)
+		{
+			block = ConstraintBlock();
+			std::fill(std::begin(block.contact), std::end(block.contact), NoContact);
+		}
+
+		uint32_t fill[MaxColors + 1] = {};
+		for (uint32_t c = 0; c < uint32_t(contacts.size()); ++c)
+		{
+			const uint32_t color = m_contactColor[c];
+			if (color == NoContact)
+			{
+				continue;
+			}
+			const uint32_t slot = fill[color]++;
+			const uint32_t lanes = color == overflow ? 1 : Width;
+			ConstraintBlock& block = m_blocks[m_colorStart[color] + slot / lanes];
+			const uint32_t lane = slot % lanes;
+
+			const Contact& contact = contacts[c];
+			const SolverBody& a = bodies[contact.a];
+			const SolverBody& b = bodies[contact.b];
+			const float mass = 1.0f / (a.inverseMass + b.inverseMass);
+			block.contact[lane] = c;
+			block.bodyA[lane] = contact.a;
+			block.bodyB[lane] = contact.b;
+			block.normalX[lane] = contact.normal.x;
+			block.normalY[lane] = contact.normal.y;
+			block.inverseMassA[lane] = a.inverseMass;
+			block.inverseMassB[lane] = b.inverseMass;
+			// Bounce is decided from the velocities before any impulse or force of this step
+			const glm::vec2 forceA = a.inverseMass > 0.0f ? settings.gravity * deltaTime : glm::vec2(0);
+			const glm::vec2 forceB = b.inverseMass > 0.0f ? settings.gravity * deltaTime : glm::vec2(0);
+			block.approach[lane] = -glm::dot((b.velocity - forceB) - (a.velocity - forceA), contact.normal);
+			block.restitution[lane] = std::max(a.restitution, b.restitution);
+			for (uint32_t i = 0; i < contact.pointCount; ++i)
+			{
+				const ContactPoint& point = contact.points[i];
+				block.mass[i][lane] = mass;
+				block.depth[i][lane] = point.depth;
+				// Points that do not touch yet may approach until they do, but no further
+				block.bias[i][lane] = std::min(point.depth, 0.0f) / deltaTime;
+				block.normalImpulse[i][lane] = settings.warmStarting ? point.normalImpulse : 0.0f;
+				block.tangentImpulse[i][lane] = settings.warmStarting ? point.tangentImpulse : 0.0f;
+			}
+		}
+	}
+
+	template<typename Function>
+	void ContactSolver::forEachBlock(const SolverSettings& settings, Function function) {
+		const uint32_t threads = m_jobs.getThreadCount();
+		const uint32_t minBlocks = std::max(settings.minBlocksPerChunk, 1u);
+		for (uint32_t color = 0; color <= MaxColors; ++color)
+		{
+			const uint32_t begin = m_colorStart[color];
+			const uint32_t end = m_colorStart[color + 1];
+			const uint32_t count = end - begin;
+			const uint32_t chunks = std::min(threads * 4, count / minBlocks);
+			if (color == MaxColors || threads == 1 || chunks < 2)
+			{
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					function(m_blocks[i]);
+				}
+				continue;
+			}
+
+			// Returning from run() is the barrier before the next color
+			m_jobs.run(chunks, [&](uint32_t chunk) {
+				const uint32_t first = begin + uint32_t(uint64_t(count) * chunk / chunks);
+				const uint32_t last = begin + uint32_t(uint64_t(count) * (chunk + 1) / chunks);
+				for (uint32_t i = first; i < last; ++i)
+				{
+					function(m_blocks[i]);
+				}
+			});
+		}
+	}
+
+	void ContactSolver::solveVelocities(std::vector<Contact>& contacts, std::vector<SolverBody>& bodies, const SolverSettings& settings, float deltaTime) {
+		buildBlocks(contacts, bodies, settings, deltaTime);
+		const Wide zero = Wide::splat(0.0f);
+		const Wide friction = Wide::splat(settings.friction);
+
+		// Warm start with the impulses of last step
+		if (settings.warmStarting)
+		{
+			forEachBlock(settings, [&](ConstraintBlock& block) {
+				WideBodies v = gather(block, bodies, &SolverBody::velocity);
+				const Wide nx = Wide::load(block.normalX), ny = Wide::load(block.normalY);
+				const Wide imA = Wide::load(block.inverseMassA), imB = Wide::load(block.inverseMassB);
+				for (uint32_t i = 0; i < 2; ++i)
+				{
+					const Wide n = Wide::load(block.normalImpulse[i]);
+					const Wide t = Wide::load(block.tangentImpulse[i]);
+					// Tangent is the normal turned 90 degrees: (-ny, nx)
+					applyImpulse(v, imA, imB, n * nx - t * ny, n * ny + t * nx);
+				}
+				scatter(block, bodies, &SolverBody::velocity, v);
+			});
+		}
+
+		for (uint32_t iteration = 0; iteration < settings.velocityIterations; ++iteration)
+		{
+			forEachBlock(settings, [&](ConstraintBlock& block) {
+				WideBodies v = gather(block, bodies, &SolverBody::velocity);
+				const Wide nx = Wide::load(block.normalX), ny = Wide::load(block.normalY);
+				const Wide imA = Wide::load(block.inverseMassA), imB = Wide::load(block.inverseMassB);
+				for (uint32_t i = 0; i < 2; ++i)
+				{
+					// A missing point has mass 0, so its impulses stay 0
+					const Wide mass = Wide::load(block.mass[i]);
+					Wide normalImpulse = Wide::load(block.normalImpulse[i]);
+					Wide tangentImpulse = Wide::load(block.tangentImpulse[i]);
+
+					// Friction first, bounded by the normal impulse of the point
+					Wide vt = (v.by - v.ay) * nx - (v.bx - v.ax) * ny;
+					Wide maxFriction = friction * normalImpulse;
+					Wide newTangent = clamp(tangentImpulse - vt * mass, -maxFriction, maxFriction);
+					Wide delta = newTangent - tangentImpulse;
+					tangentImpulse = newTangent;
+					applyImpulse(v, imA, imB, -(delta * ny), delta * nx);
+
+					// Then non-penetration, the accumulated impulse may only push
+					Wide vn = (v.bx - v.ax) * nx + (v.by - v.ay) * ny;
+					Wide newNormal = max(normalImpulse + (Wide::load(block.bias[i]) - vn) * mass, zero);
+					delta = newNormal - normalImpulse;
+					normalImpulse = newNormal;
+					applyImpulse(v, imA, imB, delta * nx, delta * ny);
+
+					normalImpulse.store(block.normalImpulse[i]);
+					tangentImpulse.store(block.tangentImpulse[i]);
+					max(Wide::load(block.maxNormalImpulse[i]), normalImpulse).store(block.maxNormalImpulse[i]);
+				}
+				scatter(block, bodies, &SolverBody::velocity, v);
+			});
+		}
+
+		// Bounce last, only points that were hit fast enough and actually pushed
+		forEachBlock(settings, [&](ConstraintBlock& block) {
+			alignas(32) float bounceMass[2][Width];
+			alignas(32) float target[Width];
+			bool bounces = false;
+			for (uint32_t lane = 0; lane < Width; ++lane)
+			{
+				const bool fast = block.approach[lane] > settings.restitutionThreshold && block.restitution[lane] > 0.0f;
+				target[lane] = block.restitution[lane] * block.approach[lane];
+				for (uint32_t i = 0; i < 2; ++i)
+				{
+					const bool bounce = fast && block.maxNormalImpulse[i][lane] > 0.0f;
+					bounceMass[i][lane] = bounce ? block.mass[i][lane] : 0.0f;
+					bounces |= bounce;
+				}
+			}
+			if (!bounces)
+			{
+				return;
+			}
+
+			WideBodies v = gather(block, bodies, &SolverBody::velocity);
+			const Wide nx = Wide::load(block.normalX), ny = Wide::load(block.normalY);
+			const Wide imA = Wide::load(block.inverseMassA), imB = Wide::load(block.inverseMassB);
+			for (uint32_t i = 0; i < 2; ++i)
+			{
+				const Wide mass = Wide::load(bounceMass[i]);
+				Wide normalImpulse = Wide::load(block.normalImpulse[i]);
+				Wide vn = (v.bx - v.ax) * nx + (v.by - v.ay) * ny;
+				Wide newNormal = max(normalImpulse + (Wide::load(target) - vn) * mass, zero);
+				Wide delta = newNormal - normalImpulse;
+				applyImpulse(v, imA, imB, delta * nx, delta * ny);
+				newNormal.store(block.normalImpulse[i]);
+			}
+			scatter(block, bodies, &SolverBody::velocity, v);
+		});
+
+		// Accumulated impulses go back to the contacts for the contact cache
+		for (const auto& block : m_blocks)
+		{
+			for (uint32_t lane = 0; lane < Width; ++lane)
+			{
+				if (block.contact[lane] == NoContact)
+				{
+					continue;
+				}
+				Contact& contact = contacts[block.contact[lane]];
+				for (uint32_t i = 0; i < contact.pointCount; ++i)
+				{
+					contact.points[i].normalImpulse = block.normalImpulse[i][lane];
+					contact.points[i].tangentImpulse = block.tangentImpulse[i][lane];
+				}
+			}
+		}
+	}
+
+	void ContactSolver::solvePositions(std::vector<SolverBody>& bodies, const SolverSettings& settings) {
+		const Wide zero = Wide::splat(0.0f);
+		const Wide baumgarte = Wide::splat(settings.baumgarte);
+		const Wide linearSlop = Wide::splat(settings.linearSlop);
+		const Wide maxCorrection = Wide::splat(settings.maxCorrection);
+		for (uint32_t iteration = 0; iteration < settings.positionIterations; ++iteration)
+		{
+			forEachBlock(settings, [&](ConstraintBlock& block) {
+				WideBodies d = gather(block, bodies, &SolverBody::displacement);
+				const Wide nx = Wide::load(block.normalX), ny = Wide::load(block.normalY);
+				const Wide imA = Wide::load(block.inverseMassA), imB = Wide::load(block.inverseMassB);
+				for (uint32_t i = 0; i < 2; ++i)
+				{
+					// Depth after this step's movement so far, then push out a share of it
+					Wide depth = Wide::load(block.depth[i]) - ((d.bx - d.ax) * nx + (d.by - d.ay) * ny);
+					Wide correction = clamp(baumgarte * (depth - linearSlop), zero, maxCorrection);
+					Wide push = correction * Wide::load(block.mass[i]);
+					applyImpulse(d, imA, imB, push * nx, push * ny);
+				}
+				scatter(block, bodies, &SolverBody::displacement, d);
+			});
+		}
+	}
+}
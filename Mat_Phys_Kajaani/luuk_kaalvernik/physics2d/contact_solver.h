@@ -0,0 +1,117 @@
+#pragma once
+#include <physics2d/contact.h>
+#include <physics2d/job_system.h>
+#include <physics2d/memory_usage.h>
+#include <vector>
+
+namespace physics2d {
+	struct SolverSettings {
+		uint32_t velocityIterations = 8;
+		uint32_t positionIterations = 3;
+		float restitutionThreshold = 1.0f; // Slower approaches do not bounce, so resting bodies stay at rest
+		// Gravity the moving bodies already got this step. It is left out of the approach speed,
+		// otherwise every bounce gets gravity * deltaTime extra and a body at rest keeps hopping.
+		glm::vec2 gravity = glm::vec2(0);
+		float friction = 0.3f;
+		float baumgarte = 0.2f; // Share of the penetration pushed out per position iteration
+		float linearSlop = 0.005f; // Penetration left alone, so resting contacts persist between steps
+		float maxCorrection = 0.2f; // Deep penetrations are pushed out over several steps instead of at once
+		bool warmStarting = true;
+		uint32_t minBlocksPerChunk = 16; // Smallest amount of work worth handing to another thread
+	};
+
+	///
+	/// \brief A body as seen by the solver, indexed by proxy id. Static bodies have inverseMass 0.
+	///
+	struct SolverBody {
+		glm::vec2 velocity;
+		glm::vec2 displacement; // Movement during this step
+		float inverseMass;
+		float restitution; // A contact bounces with the larger restitution of its two bodies
+	};
+
+	///
+	/// \brief Sequential impulse solver for non-penetration and friction of contacts.
+	///
+	/// Each iteration applies an impulse per contact point that corrects the relative
+	/// velocity along the normal, clamped so the accumulated impulse never pulls.
+	/// Accumulated impulses are kept in the contact points. With warm starting they
+	/// are applied up front, so contacts coming from ContactCache::warmStart()
+	/// start close to last step's solution.
+	///
+	/// Contacts may start before the shapes touch (negative depth). Such points let
+	/// the bodies approach until they touch, which stops them before they sink in.
+	/// Penetration that happens anyway is removed by moving the bodies in a separate
+	/// pass instead of adding velocity, otherwise the corrections of a tall stack add
+	/// up to a velocity that launches the top of the stack. Restitution is applied
+	/// after the iterations, to points that were hit faster than restitutionThreshold.
+	///
+	/// Contacts are graph colored so that no two contacts of a color share a moving
+	/// body. A color is then solved in blocks of SimdWidth contacts, one contact per
+	/// SIMD lane, and the blocks are spread over the job system. Static bodies do
+	/// not count for coloring since the solver never writes them. The result does not
+	/// depend on the number of threads.
+	///
+	class ContactSolver {
+	public:
+#if defined(__AVX__)
+		static constexpr uint32_t SimdWidth = 8;
+#elif defined(__SSE2__) || defined(_M_X64)
+		static constexpr uint32_t SimdWidth = 4;
+#else
+		static constexpr uint32_t SimdWidth = 1;
+#endif
+		static constexpr uint32_t MaxColors = 12; // Contacts that do not fit are solved on one thread
+
+		explicit ContactSolver(JobSystem& jobs);
+
+		///
+		/// \brief Changes the velocities of bodies so the contacts stop approaching.
+		///
+		void solveVelocities(std::vector<Contact>& contacts, std::vector<SolverBody>& bodies, const SolverSettings& settings, float deltaTime);
+
+		///
+		/// \brief Adjusts the displacements of bodies to push out of the penetration the contacts will have after moving.
+		/// Call it after solveVelocities() with displacement = velocity * deltaTime.
+		///
+		void solvePositions(std::vector<SolverBody>& bodies, const SolverSettings& settings);
+
+		uint32_t getColorCount() const { return m_colorCount; }
+		size_t getMemoryUsage() const { return physics2d::getMemoryUsage(m_blocks, m_colorStart, m_contactColor, m_colorBodies); }
+
+	private:
+		// SimdWidth contacts with no moving body in common, stored component wise
+		struct alignas(32) ConstraintBlock {
+			uint32_t contact[SimdWidth]; // Index into the contacts, ~0 for unused lanes
+			uint32_t bodyA[SimdWidth];
+			uint32_t bodyB[SimdWidth];
+			float normalX[SimdWidth];
+			float normalY[SimdWidth];
+			float inverseMassA[SimdWidth]; // 0 for static bodies and unused lanes, which are never written
+			float inverseMassB[SimdWidth];
+			float mass[2][SimdWidth]; // Effective mass of each point, 0 if the point does not exist
+			float approach[SimdWidth]; // Normal speed towards each other before solving
+			float restitution[SimdWidth];
+			float bias[2][SimdWidth]; // Lowest normal velocity allowed for each point
+			float depth[2][SimdWidth];
+			float normalImpulse[2][SimdWidth];
+			float tangentImpulse[2][SimdWidth];
+			float maxNormalImpulse[2][SimdWidth];
+		};
+
+		void buildBlocks(const std::vector<Contact>& contacts, const std::vector<SolverBody>& bodies, const SolverSettings& settings, float deltaTime);
+
+		///
+		/// \brief Calls function(block) for every block, color after color. Blocks of a color run in parallel.
+		///
+		template<typename Function>
+		void forEachBlock(const SolverSettings& settings, Function function);
+
+		JobSystem& m_jobs;
+		std::vector<ConstraintBlock> m_blocks;
+		std::vector<uint32_t> m_colorStart; // Blocks of color i are m_colorStart[i]..m_colorStart[i + 1]
+		uint32_t m_colorCount = 0;
+		std::vector<uint32_t> m_contactColor;
+		std::vector<uint32_t> m_colorBodies; // One bit per body and color, set if a contact of that color moves it
+	};
+}
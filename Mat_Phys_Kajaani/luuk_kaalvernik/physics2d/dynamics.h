@@ -0,0 +1,22 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace physics2d {
+	///
+	/// \brief Explicit Euler step with gravity for a container of bodies.
+	/// Static and sleeping bodies only get their oldPosition updated.
+	///
+	void simulate(auto& objects, float deltaTime) {
+		for (auto& obj : objects){
+			obj.oldPosition = obj.position;
+			if (obj.isStatic || obj.isSleeping)
+			{
+				continue;
+			}
+			glm::vec2 gravity(0, -9.81f);
+		
+			obj.velocity += gravity * deltaTime;
+			obj.position += obj.velocity * deltaTime;
+		}
+	}
+}
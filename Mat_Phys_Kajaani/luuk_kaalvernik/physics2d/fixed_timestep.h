@@ -0,0 +1,86 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace physics2d {
+	///
+	/// \brief Runs the simulation at a fixed rate, independent of the frame rate.
+	///
+	/// Frame time is accumulated and consumed in steps of exactly 1 / stepsPerSecond.
+	/// What is left over is less than one step; getAlpha() tells how far the render
+	/// time is between the last two physics states, so drawing can interpolate them.
+	///
+	/// Usage:
+	///   FixedTimestep fixedStep(240.0f);
+	///   fixedStep.advance(timer.getDeltaTime(), [&](float dt) { world.step(dt); });
+	///   draw(glm::mix(body.oldPosition, body.position, fixedStep.getAlpha()));
+	///
+	class FixedTimestep {
+	public:
+		///
+		/// \param stepsPerSecond = Simulation rate in Hz.
+		/// \param maxSteps = Most steps run for one frame. When the simulation cannot keep up,
+		/// the rest of the frame time is dropped and the game slows down instead of freezing.
+		///
+		explicit FixedTimestep(float stepsPerSecond = 240.0f, uint32_t maxSteps = 8)
+			: m_deltaTime(1.0f / stepsPerSecond)
+			, m_maxSteps(maxSteps) {
+		}
+
+		///
+		/// \brief Adds frameTime and calls step(deltaTime) for every whole step that fits.
+		/// \return Number of steps run.
+		///
+		template<typename Step>
+		uint32_t advance(float frameTime, Step step);
+
+		float getDeltaTime() const { return m_deltaTime; }
+
+		///
+		/// \brief Interpolation factor in [0, 1) between the previous and the current physics state.
+		///
+		float getAlpha() const { return m_accumulator / m_deltaTime; }
+
+		///
+		/// \brief Total simulation time dropped by the spiral of death guard.
+		///
+		double getDroppedTime() const { return m_droppedTime; }
+
+	private:
+		float m_deltaTime;
+		uint32_t m_maxSteps;
+		float m_accumulator = 0.0f;
+		double m_droppedTime = 0.0;
+	};
+
+	template<typename Step>
+	uint32_t FixedTimestep::advance(float frameTime, Step step) {
+		m_accumulator += std::max(frameTime, 0.0f);
+
+		uint32_t steps = 0;
+		while (m_accumulator >= m_deltaTime && steps < m_maxSteps)
+		{
+			step(m_deltaTime);
+			m_accumulator -= m_deltaTime;
+			++steps;
+		}
+
+		// Spiral of death guard: steps that did not fit this frame would only make the next one slower
+		if (m_accumulator >= m_deltaTime)
+		{
+			float dropped = m_accumulator - std::fmod(m_accumulator, m_deltaTime);
+			m_droppedTime += dropped;
+			m_accumulator -= dropped;
+		}
+		return steps;
+	}
+
+	///
+	/// \brief Position to draw a body at, between its state before and after the last step.
+	///
+	inline glm::vec2 interpolate(const glm::vec2& previous, const glm::vec2& current, float alpha) {
+		return previous + (current - previous) * alpha;
+	}
+}
@@ -0,0 +1,275 @@
+#include <physics2d/job_system.h>
+#include <algorithm>
+
+namespace physics2d {
+	namespace {
+		// Which queue the current thread owns. Threads of other job systems and outside threads use queue 0.
+		struct ThreadInfo {
+			const JobSystem* system = nullptr;
+			uint32_t index = 0;
+			uint32_t depth = 0; // Jobs running on this thread, a job waiting inside a job runs others
+		};
+		thread_local ThreadInfo t_thread;
+	}
+
+	JobSystem::JobSystem(uint32_t threadCount) {
+		if (threadCount == 0)
+		{
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (uint32_t i = 0; i < threadCount; ++i)
+		{
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+		m_statsStart = std::chrono::steady_clock::now();
+		for (uint32_t i = 1; i < threadCount; ++i)
+		{
+			m_workers.emplace_back([this, i] { workerLoop(i); });
+		}
+	}
+
+	JobSystem::~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_quit = true;
+		}
+		m_wakeUp.notify_all();
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	JobSystem::JobHandle JobSystem::submit(std::function<void()> function, const std::vector<JobHandle>& dependencies) {
+		auto job = std::make_shared<Job>();
+		job->function = std::move(function);
+		return schedule(std::move(job), dependencies);
+	}
+
+	JobSystem::JobHandle JobSystem::parallelFor(uint32_t count, std::function<void(uint32_t, uint32_t)> function,
+		const std::vector<JobHandle>& dependencies, uint32_t minGrain) {
+		auto job = std::make_shared<Job>();
+		job->rangeFunction = std::make_shared<std::function<void(uint32_t, uint32_t)>>(std::move(function));
+		job->end = count;
+		job->grain = std::max({ minGrain, count / (8 * getThreadCount()), 1u });
+		return schedule(std::move(job), dependencies);
+	}
+
+	JobSystem::JobHandle JobSystem::schedule(JobHandle job, const std::vector<JobHandle>& dependencies) {
+		// Jobs that finish later run this one when they are done, see finish()
+		for (const auto& dependency : dependencies)
+		{
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (!dependency->done)
+			{
+				++job->dependencies;
+				dependency->continuations.push_back(job);
+			}
+		}
+		if (--job->dependencies == 0)
+		{
+			push(getCurrentIndex(), job);
+		}
+		return job;
+	}
+
+	void JobSystem::wait(const JobHandle& job) {
+		const uint32_t index = getCurrentIndex();
+		while (!job->done)
+		{
+			if (JobHandle next = findJob(index))
+			{
+				execute(index, std::move(next));
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::run(uint32_t chunkCount, const std::function<void(uint32_t)>& task) {
+		// Not worth queueing anything for a single chunk
+		if (m_workers.empty() || chunkCount <= 1)
+		{
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				task(chunk);
+			}
+			return;
+		}
+		wait(parallelFor(chunkCount, [&task](uint32_t begin, uint32_t end) {
+			for (uint32_t chunk = begin; chunk < end; ++chunk)
+			{
+				task(chunk);
+			}
+		}));
+	}
+
+	std::vector<JobSystem::WorkerStats> JobSystem::getWorkerStats() const {
+		const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_statsStart).count();
+		std::vector<WorkerStats> stats;
+		for (const auto& queue : m_queues)
+		{
+			WorkerStats worker;
+			worker.jobs = queue->jobCount.load(std::memory_order_relaxed);
+			worker.steals = queue->stealCount.load(std::memory_order_relaxed);
+			worker.busySeconds = 1e-9 * double(queue->busyNanoseconds.load(std::memory_order_relaxed));
+			worker.utilization = elapsed > 0.0 ? worker.busySeconds / elapsed : 0.0;
+			stats.push_back(worker);
+		}
+		return stats;
+	}
+
+	void JobSystem::resetStats() {
+		for (auto& queue : m_queues)
+		{
+			queue->jobCount = 0;
+			queue->stealCount = 0;
+			queue->busyNanoseconds = 0;
+		}
+		m_statsStart = std::chrono::steady_clock::now();
+	}
+
+	void JobSystem::workerLoop(uint32_t index) {
+		t_thread.system = this;
+		t_thread.index = index;
+		while (!m_quit)
+		{
+			if (JobHandle job = findJob(index))
+			{
+				execute(index, std::move(job));
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_wakeUp.wait(lock, [&] { return m_quit || m_queued > 0; });
+		}
+	}
+
+	uint32_t JobSystem::getCurrentIndex() const {
+		return t_thread.system == this ? t_thread.index : 0;
+	}
+
+	void JobSystem::push(uint32_t index, JobHandle job) {
+		{
+			std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+			m_queues[index]->jobs.push_back(std::move(job));
+		}
+		++m_queued;
+		if (!m_workers.empty())
+		{
+			// Taking the lock makes sure a worker about to sleep sees m_queued first
+			{
+				std::lock_guard<std::mutex> lock(m_sleepMutex);
+			}
+			m_wakeUp.notify_one();
+		}
+	}
+
+	JobSystem::JobHandle JobSystem::pop(uint32_t index) {
+		Queue& queue = *m_queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+		{
+			return nullptr;
+		}
+		JobHandle job = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+		--m_queued;
+		return job;
+	}
+
+	JobSystem::JobHandle JobSystem::steal(uint32_t index) {
+		const uint32_t count = uint32_t(m_queues.size());
+		for (uint32_t i = 1; i < count; ++i)
+		{
+			Queue& victim = *m_queues[(index + i) % count];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty())
+			{
+				JobHandle job = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				--m_queued;
+				++m_queues[index]->stealCount;
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	JobSystem::JobHandle JobSystem::findJob(uint32_t index) {
+		if (m_queued == 0)
+		{
+			return nullptr;
+		}
+		JobHandle job = pop(index);
+		return job ? job : steal(index);
+	}
+
+	void JobSystem::execute(uint32_t index, JobHandle job) {
+		// Only the outermost job is timed, a job waiting inside a job would count twice
+		const bool timed = t_thread.depth++ == 0;
+		const auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+		if (job->rangeFunction)
+		{
+			runRange(index, job);
+		}
+		else if (job->function)
+		{
+			job->function();
+		}
+		--t_thread.depth;
+		++m_queues[index]->jobCount;
+		if (timed)
+		{
+			auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			m_queues[index]->busyNanoseconds += uint64_t(nanoseconds);
+		}
+		finish(index, job);
+	}
+
+	void JobSystem::runRange(uint32_t index, const JobHandle& job) {
+		// Keep the first half and queue the second, so the oldest queued job is always the biggest
+		const JobHandle& root = job->parent ? job->parent : job;
+		while (job->end - job->begin > job->grain)
+		{
+			const uint32_t middle = job->begin + (job->end - job->begin) / 2;
+			auto half = std::make_shared<Job>();
+			half->rangeFunction = job->rangeFunction;
+			half->begin = middle;
+			half->end = job->end;
+			half->grain = job->grain;
+			half->parent = root;
+			half->dependencies = 0;
+			++root->unfinished;
+			push(index, std::move(half));
+			job->end = middle;
+		}
+		(*job->rangeFunction)(job->begin, job->end);
+	}
+
+	void JobSystem::finish(uint32_t index, const JobHandle& job) {
+		if (--job->unfinished != 0)
+		{
+			return;
+		}
+
+		std::vector<JobHandle> continuations;
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->done = true;
+			continuations.swap(job->continuations);
+		}
+		for (auto& continuation : continuations)
+		{
+			if (--continuation->dependencies == 0)
+			{
+				push(index, std::move(continuation));
+			}
+		}
+		if (job->parent)
+		{
+			finish(index, job->parent);
+		}
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Work stealing job scheduler.
+	///
+	/// Every thread has its own deque of jobs. A thread pushes and pops jobs at the
+	/// back of its own deque, newest first, which keeps the data it just touched in
+	/// cache. A thread that runs out of work steals the oldest job from the front
+	/// of another deque. Old jobs are the biggest halves of split loops, so a steal
+	/// takes a lot of work at once and busy threads are rarely disturbed.
+	///
+	/// A job may depend on other jobs and only becomes runnable when all of them are
+	/// done, so a frame can be submitted as a graph of stages and waited on once.
+	/// The thread calling wait() runs jobs too. A system of N threads starts N-1
+	/// workers, and with a single thread every job runs inside wait().
+	///
+	/// Usage:
+	///   auto integrate = jobs.parallelFor(count, [&](uint32_t begin, uint32_t end) { ... });
+	///   auto collide = jobs.submit([&] { ... }, { integrate });
+	///   jobs.wait(collide);
+	///
+	class JobSystem {
+	public:
+		struct Job;
+		using JobHandle = std::shared_ptr<Job>;
+
+		///
+		/// \brief Counters of one thread since the last resetStats(). Thread 0 is the one calling wait().
+		///
+		struct WorkerStats {
+			uint64_t jobs = 0;
+			uint64_t steals = 0; // Jobs taken from another thread's deque
+			double busySeconds = 0; // Time spent running jobs
+			double utilization = 0; // busySeconds divided by the time since resetStats()
+		};
+
+		///
+		/// \brief threadCount = Total number of threads running jobs, 0 picks the number of cores.
+		///
+		explicit JobSystem(uint32_t threadCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		uint32_t getThreadCount() const { return uint32_t(m_workers.size()) + 1; }
+
+		///
+		/// \brief Queues function to run once every job in dependencies is done.
+		///
+		JobHandle submit(std::function<void()> function, const std::vector<JobHandle>& dependencies = {});
+
+		///
+		/// \brief Calls function(begin, end) over ranges covering [0, count), once dependencies are done.
+		/// The range is split in halves down to a grain of about count / (8 * threads) items, but
+		/// never below minGrain. Idle threads steal the big halves first, so uneven items even out.
+		/// \return Handle that is done when every range is.
+		///
+		JobHandle parallelFor(uint32_t count, std::function<void(uint32_t, uint32_t)> function,
+			const std::vector<JobHandle>& dependencies = {}, uint32_t minGrain = 1);
+
+		///
+		/// \brief Runs queued jobs until job is done.
+		///
+		void wait(const JobHandle& job);
+
+		///
+		/// \brief Calls task(chunk) for every chunk in [0, chunkCount) and waits until all are done.
+		///
+		void run(uint32_t chunkCount, const std::function<void(uint32_t)>& task);
+
+		std::vector<WorkerStats> getWorkerStats() const;
+		void resetStats();
+
+	private:
+		// Padded so threads updating their own counters do not share cache lines
+		struct alignas(64) Queue {
+			std::mutex mutex;
+			std::deque<JobHandle> jobs;
+			std::atomic<uint64_t> jobCount{ 0 };
+			std::atomic<uint64_t> stealCount{ 0 };
+			std::atomic<uint64_t> busyNanoseconds{ 0 };
+		};
+
+		JobHandle schedule(JobHandle job, const std::vector<JobHandle>& dependencies);
+		void workerLoop(uint32_t index);
+		uint32_t getCurrentIndex() const;
+		void push(uint32_t index, JobHandle job);
+		JobHandle pop(uint32_t index);
+		JobHandle steal(uint32_t index);
+		JobHandle findJob(uint32_t index);
+		void execute(uint32_t index, JobHandle job);
+		void runRange(uint32_t index, const JobHandle& job);
+		void finish(uint32_t index, const JobHandle& job);
+
+		std::vector<std::unique_ptr<Queue>> m_queues; // One per thread, 0 belongs to the thread calling wait()
+		std::vector<std::thread> m_workers;
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wakeUp;
+		std::atomic<uint32_t> m_queued{ 0 };
+		std::atomic<bool> m_quit{ false };
+		std::chrono::steady_clock::time_point m_statsStart;
+	};
+
+	struct JobSystem::Job {
+		std::function<void()> function;
+
+		// Set for parallelFor() jobs, which split [begin, end) in halves while it is bigger than grain
+		std::shared_ptr<std::function<void(uint32_t, uint32_t)>> rangeFunction;
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		uint32_t grain = 1;
+		JobHandle parent; // The parallelFor() job a split off range belongs to
+
+		std::atomic<uint32_t> dependencies{ 1 }; // Unfinished dependencies, plus one until submitted
+		std::atomic<uint32_t> unfinished{ 1 }; // Own work plus split off ranges still running
+		std::atomic<bool> done{ false };
+		std::mutex mutex;
+		std::vector<JobHandle> continuations; // Jobs waiting for this one
+	};
+}
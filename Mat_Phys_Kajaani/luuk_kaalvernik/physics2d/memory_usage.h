@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Bytes allocated by vector, which follows its capacity rather than its size.
+	///
+	template<typename T>
+	size_t getMemoryUsage(const std::vector<T>& vector) {
+		return vector.capacity() * sizeof(T);
+	}
+
+	inline size_t getMemoryUsage(const std::vector<bool>& vector) {
+		return vector.capacity() / 8;
+	}
+
+	template<typename T>
+	size_t getMemoryUsage(const std::vector<std::vector<T>>& vectors) {
+		size_t bytes = vectors.capacity() * sizeof(std::vector<T>);
+		for (const auto& vector : vectors)
+		{
+			bytes += getMemoryUsage(vector);
+		}
+		return bytes;
+	}
+
+	///
+	/// \brief Sum of the bytes allocated by every argument.
+	///
+	template<typename First, typename Second, typename... Rest>
+	size_t getMemoryUsage(const First& first, const Second& second, const Rest&... rest) {
+		return getMemoryUsage(first) + (getMemoryUsage(second) + ... + getMemoryUsage(rest));
+	}
+}
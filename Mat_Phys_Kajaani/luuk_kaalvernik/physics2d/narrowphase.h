@@ -0,0 +1,82 @@
+#pragma once
+#include <physics2d/aabb.h>
+#include <physics2d/contact.h>
+#include <physics2d/job_system.h>
+#include <physics2d/memory_usage.h>
+#include <algorithm>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Runs the narrowphase tests of all candidate pairs on the job system.
+	///
+	/// Detection only reads the bodies, responding to the contacts is left to the caller.
+	/// Pairs are split into contiguous chunks that each write to their own contact
+	/// buffer. Buffers are merged in chunk order, so contacts always come out in pair
+	/// order and the result is identical for any number of threads.
+	///
+	class Narrowphase {
+	public:
+		///
+		/// \brief minPairsPerChunk = Smallest amount of work worth handing to another thread.
+		///
+		explicit Narrowphase(JobSystem& jobs, uint32_t minPairsPerChunk = 256);
+
+		///
+		/// \brief Replaces contacts with the contacts found among pairs.
+		/// \param test = bool(const ProxyPair&, Contact&), fills in the manifold of the contact whose
+		/// proxies are already set. Must be safe to call from many threads.
+		///
+		template<typename TestFunc>
+		void detect(const std::vector<ProxyPair>& pairs, TestFunc test, std::vector<Contact>& contacts);
+
+		size_t getMemoryUsage() const { return physics2d::getMemoryUsage(m_buffers); }
+
+	private:
+		JobSystem& m_jobs;
+		uint32_t m_minPairsPerChunk;
+		std::vector<std::vector<Contact>> m_buffers;
+	};
+
+	inline Narrowphase::Narrowphase(JobSystem& jobs, uint32_t minPairsPerChunk)
+		: m_jobs(jobs)
+		, m_minPairsPerChunk(minPairsPerChunk) {
+	}
+
+	template<typename TestFunc>
+	void Narrowphase::detect(const std::vector<ProxyPair>& pairs, TestFunc test, std::vector<Contact>& contacts) {
+		const uint32_t pairCount = uint32_t(pairs.size());
+		// A few chunks per thread balance uneven chunks, but never less than minPairsPerChunk each
+		uint32_t chunkCount = std::min(4 * m_jobs.getThreadCount(), pairCount / m_minPairsPerChunk);
+		chunkCount = std::max(chunkCount, 1u);
+		const uint32_t chunkSize = (pairCount + chunkCount - 1) / chunkCount;
+
+		if (m_buffers.size() < chunkCount)
+		{
+			m_buffers.resize(chunkCount);
+		}
+
+		m_jobs.run(chunkCount, [&](uint32_t chunk) {
+			auto& buffer = m_buffers[chunk];
+			buffer.clear();
+			const uint32_t begin = std::min(chunk * chunkSize, pairCount);
+			const uint32_t end = std::min(begin + chunkSize, pairCount);
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				Contact contact;
+				contact.a = pairs[i].a;
+				contact.b = pairs[i].b;
+				if (test(pairs[i], contact))
+				{
+					buffer.push_back(contact);
+				}
+			}
+		});
+
+		contacts.clear();
+		for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			contacts.insert(contacts.end(), m_buffers[chunk].begin(), m_buffers[chunk].end());
+		}
+	}
+}
@@ -0,0 +1,147 @@
+#include <physics2d/profiler.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace physics2d {
+	namespace {
+		// Innermost zone open on this thread
+		thread_local ProfileZone* t_zone = nullptr;
+	}
+
+	Profiler& Profiler::get() {
+		static Profiler profiler;
+		return profiler;
+	}
+
+	Profiler::Profiler() {
+		m_frameStart = now();
+		setHistorySize(300);
+	}
+
+	uint64_t Profiler::now() {
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	uint32_t Profiler::registerZone(const char* name) {
+		std::lock_guard<std::mutex> lock(m_zoneMutex);
+		const uint32_t count = m_zoneCount.load(std::memory_order_relaxed);
+		for (uint32_t zone = 0; zone < count; ++zone)
+		{
+			if (m_zoneNames[zone] == name)
+			{
+				return zone;
+			}
+		}
+		if (count == MaxZones)
+		{
+			return MaxZones - 1;
+		}
+		m_zoneNames[count] = name;
+		m_zoneCount.store(count + 1, std::memory_order_release);
+		return count;
+	}
+
+	void Profiler::endFrame() {
+		const uint64_t end = now();
+		Frame& frame = m_frames[m_nextFrame];
+		frame.seconds = 1e-9 * double(end - m_frameStart);
+		for (uint32_t zone = 0; zone < MaxZones; ++zone)
+		{
+			frame.zoneSeconds[zone] = 1e-9 * double(m_current[zone].exchange(0, std::memory_order_relaxed));
+		}
+		m_frameStart = end;
+		m_nextFrame = (m_nextFrame + 1) % uint32_t(m_frames.size());
+		m_frameCount = std::min(m_frameCount + 1, uint32_t(m_frames.size()));
+	}
+
+	void Profiler::setHistorySize(uint32_t frames) {
+		m_frames.assign(std::max(1u, frames), Frame());
+		m_nextFrame = 0;
+		m_frameCount = 0;
+	}
+
+	const Profiler::Frame& Profiler::getFrame(uint32_t age) const {
+		const uint32_t size = uint32_t(m_frames.size());
+		return m_frames[(m_nextFrame + size - 1 - age) % size];
+	}
+
+	bool Profiler::writeCsv(const std::string& path) const {
+		FILE* file = std::fopen(path.c_str(), "w");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		const uint32_t zones = getZoneCount();
+		std::fprintf(file, "frame,frame_ms");
+		for (uint32_t zone = 0; zone < zones; ++zone)
+		{
+			std::fprintf(file, ",%s", m_zoneNames[zone].c_str());
+		}
+		std::fprintf(file, "\n");
+		for (uint32_t i = 0; i < m_frameCount; ++i)
+		{
+			const Frame& frame = getFrame(m_frameCount - 1 - i);
+			std::fprintf(file, "%u,%.4f", i, 1e3 * frame.seconds);
+			for (uint32_t zone = 0; zone < zones; ++zone)
+			{
+				std::fprintf(file, ",%.4f", 1e3 * frame.zoneSeconds[zone]);
+			}
+			std::fprintf(file, "\n");
+		}
+		return std::fclose(file) == 0;
+	}
+
+	bool Profiler::writeJson(const std::string& path) const {
+		FILE* file = std::fopen(path.c_str(), "w");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		const uint32_t zones = getZoneCount();
+		std::fprintf(file, "{\n  \"zones\": [");
+		for (uint32_t zone = 0; zone < zones; ++zone)
+		{
+			std::fprintf(file, "%s\"%s\"", zone == 0 ? "" : ", ", m_zoneNames[zone].c_str());
+		}
+		std::fprintf(file, "],\n  \"frames\": [\n");
+		for (uint32_t i = 0; i < m_frameCount; ++i)
+		{
+			const Frame& frame = getFrame(m_frameCount - 1 - i);
+			std::fprintf(file, "    { \"frame_ms\": %.4f, \"zone_ms\": [", 1e3 * frame.seconds);
+			for (uint32_t zone = 0; zone < zones; ++zone)
+			{
+				std::fprintf(file, "%s%.4f", zone == 0 ? "" : ", ", 1e3 * frame.zoneSeconds[zone]);
+			}
+			std::fprintf(file, "] }%s\n", i + 1 == m_frameCount ? "" : ",");
+		}
+		std::fprintf(file, "  ]\n}\n");
+		return std::fclose(file) == 0;
+	}
+
+	ProfileZone::ProfileZone(uint32_t zone)
+		: m_zone(zone)
+		, m_active(Profiler::get().isEnabled()) {
+		if (m_active)
+		{
+			m_parent = t_zone;
+			t_zone = this;
+			m_start = Profiler::now();
+		}
+	}
+
+	ProfileZone::~ProfileZone() {
+		if (!m_active)
+		{
+			return;
+		}
+		const uint64_t elapsed = Profiler::now() - m_start;
+		Profiler::get().addTime(m_zone, elapsed - std::min(elapsed, m_children));
+		if (m_parent != nullptr)
+		{
+			m_parent->m_children += elapsed;
+		}
+		t_zone = m_parent;
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Frame profiler fed by ProfileZone timers.
+	///
+	/// Every zone adds its own time to the current frame, minus the time of the
+	/// zones nested inside it on the same thread. So the zones of a frame add up to
+	/// the CPU time spent inside zones, and a stacked bar of them never counts the
+	/// same work twice. Zones running on worker threads add to the same frame, so
+	/// a frame that ran on many threads can take more zone time than wall time.
+	///
+	/// endFrame() moves the current times into a ring buffer of the last frames,
+	/// which can be written out as CSV or JSON for offline analysis.
+	///
+	/// Zones are placed with PHYSICS2D_PROFILE_ZONE("name"). Without the
+	/// PHYSICS2D_PROFILE define the macro compiles to nothing, and with it a zone
+	/// costs one atomic load while the profiler is disabled. The profiler starts
+	/// disabled, so zones only record once setEnabled(true) is called.
+	///
+	class Profiler {
+	public:
+		static constexpr uint32_t MaxZones = 32;
+
+		struct Frame {
+			double seconds = 0; // Wall time since the previous endFrame()
+			std::array<double, MaxZones> zoneSeconds{};
+		};
+
+		static Profiler& get();
+
+		///
+		/// \brief Returns the id of the zone called name, adding it if it is new.
+		/// Zones past MaxZones all share the last id.
+		///
+		uint32_t registerZone(const char* name);
+
+		void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+		bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+		///
+		/// \brief Adds nanoseconds to zone in the current frame. Safe to call from any thread.
+		///
+		void addTime(uint32_t zone, uint64_t nanoseconds) {
+			m_current[zone].fetch_add(nanoseconds, std::memory_order_relaxed);
+		}
+
+		///
+		/// \brief Closes the current frame and starts the next one. Call once per rendered frame.
+		///
+		void endFrame();
+
+		///
+		/// \brief Number of frames kept, older frames are overwritten. Clears the kept frames.
+		///
+		void setHistorySize(uint32_t frames);
+
+		uint32_t getZoneCount() const { return m_zoneCount.load(std::memory_order_acquire); }
+		const std::string& getZoneName(uint32_t zone) const { return m_zoneNames[zone]; }
+
+		///
+		/// \brief Number of frames kept, at most the history size.
+		///
+		uint32_t getFrameCount() const { return m_frameCount; }
+
+		///
+		/// \brief age = 0 is the last finished frame, getFrameCount() - 1 the oldest kept.
+		///
+		const Frame& getFrame(uint32_t age) const;
+
+		///
+		/// \brief Writes the kept frames oldest first, one row per frame and one column per zone, in milliseconds.
+		/// \return false if the file could not be written.
+		///
+		bool writeCsv(const std::string& path) const;
+
+		///
+		/// \brief Same data as writeCsv() as an object with the zone names and an array of frames.
+		///
+		bool writeJson(const std::string& path) const;
+
+		static uint64_t now();
+
+	private:
+		Profiler();
+
+		std::atomic<bool> m_enabled{ false };
+		std::mutex m_zoneMutex;
+		std::array<std::string, MaxZones> m_zoneNames;
+		std::atomic<uint32_t> m_zoneCount{ 0 };
+		std::array<std::atomic<uint64_t>, MaxZones> m_current{};
+		uint64_t m_frameStart = 0;
+		std::vector<Frame> m_frames; // Ring buffer
+		uint32_t m_nextFrame = 0;
+		uint32_t m_frameCount = 0;
+	};
+
+	///
+	/// \brief Times its own scope into a profiler zone. Use PHYSICS2D_PROFILE_ZONE instead of constructing it directly.
+	///
+	class ProfileZone {
+	public:
+		explicit ProfileZone(uint32_t zone);
+		~ProfileZone();
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+	private:
+		uint32_t m_zone;
+		bool m_active;
+		ProfileZone* m_parent = nullptr;
+		uint64_t m_start = 0;
+		uint64_t m_children = 0; // Time of the zones nested inside this one on the same thread
+	};
+}
+
+#define PHYSICS2D_PROFILE_CONCAT_(a, b) a##b
+#define PHYSICS2D_PROFILE_CONCAT(a, b) PHYSICS2D_PROFILE_CONCAT_(a, b)
+
+#if defined(PHYSICS2D_PROFILE)
+/// Times the rest of the enclosing scope as the zone called name. The name must be a string literal.
+#define PHYSICS2D_PROFILE_ZONE(name) \
+	static const uint32_t PHYSICS2D_PROFILE_CONCAT(profileZoneId, __LINE__) = ::physics2d::Profiler::get().registerZone(name); \
+	::physics2d::ProfileZone PHYSICS2D_PROFILE_CONCAT(profileZone, __LINE__)(PHYSICS2D_PROFILE_CONCAT(profileZoneId, __LINE__))
+#else
+#define PHYSICS2D_PROFILE_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,66 @@
+#include <physics2d/shapes.h>
+#include <cmath>
+
+namespace physics2d {
+	std::array<glm::vec2, 5> getVertices(const Box& box, float scale) {
+		glm::vec2 hs = scale * box.halfsize;
+		std::array<glm::vec2, 5> vertices = {
+			glm::vec2(-hs.x, hs.y), // Top left
+			glm::vec2(-hs.x, -hs.y), // Bottem left
+			glm::vec2(hs.x, -hs.y), // Bottem right
+			glm::vec2(hs.x, hs.y), // Top right
+			// Top left (again because we want to close "line loop")
+			glm::vec2(-hs.x, hs.y),
+		};
+
+		// 2D affine transform: same as translate * rotate * scale matrices, without building any mat4
+		if (box.rotation == 0.0f)
+		{
+			for (auto& vert : vertices)
+			{
+				vert += box.position;
+			}
+			return vertices;
+		}
+
+		float c = std::cos(box.rotation);
+		float s = std::sin(box.rotation);
+		for (auto& vert : vertices)
+		{
+			vert = box.position + glm::vec2(c * vert.x - s * vert.y, s * vert.x + c * vert.y);
+		}
+		return vertices;
+	}
+
+	const std::array<glm::vec2, 5>& getWorldVertices(Box& box) {
+		auto& cache = box.vertexCache;
+		if (!cache.valid || cache.position != box.position || cache.rotation != box.rotation || cache.halfsize != box.halfsize)
+		{
+			cache.vertices = getVertices(box, 1.0f);
+			cache.position = box.position;
+			cache.rotation = box.rotation;
+			cache.halfsize = box.halfsize;
+			cache.valid = true;
+		}
+		return cache.vertices;
+	}
+
+	AABB getAABB(const Box& box) {
+		float c = std::abs(std::cos(box.rotation));
+		float s = std::abs(std::sin(box.rotation));
+		glm::vec2 extents(c * box.halfsize.x + s * box.halfsize.y, s * box.halfsize.x + c * box.halfsize.y);
+		return makeAABB(box.position, extents);
+	}
+
+	AABB getAABB(const Sphere& sphere) {
+		return makeAABB(sphere.position, glm::vec2(sphere.radius));
+	}
+
+	float getMass(const Box& box) {
+		return 4.0f * box.halfsize.x * box.halfsize.y;
+	}
+
+	float getMass(const Sphere& sphere) {
+		return 3.14159265f * sphere.radius * sphere.radius;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <physics2d/aabb.h>
+#include <glm/glm.hpp>
+#include <array>
+
+namespace physics2d {
+	struct Box
+	{
+		glm::vec2 position;
+		glm::vec2 halfsize;
+		float rotation = 0.0f;
+		bool isColliding = false;
+		bool isStatic = false;
+		bool isSleeping = false; // Set by World, sleeping bodies are neither moved nor pair tested
+		float sleepTime = 0.0f; // How long the body has been resting
+		float restitution = 0.9f; // Share of the approach speed kept after a bounce
+		uint32_t category = 1; // Bit of the layer the body is in
+		uint32_t mask = ~0u; // Layers the body collides with, see CollisionFilter
+		glm::vec2 velocity = glm::vec2(0);
+		glm::vec2 oldPosition = glm::vec2(0);
+
+		// World space corners, only recomputed by getWorldVertices() when the box moved
+		struct VertexCache {
+			std::array<glm::vec2, 5> vertices;
+			glm::vec2 position;
+			glm::vec2 halfsize;
+			float rotation = 0.0f;
+			bool valid = false;
+		} vertexCache{};
+	};
+
+	struct Sphere {
+		glm::vec2 position;
+		float radius = 0.5f;
+		bool isColliding = false;
+		bool isStatic = false;
+		bool isSleeping = false; // Set by World, sleeping bodies are neither moved nor pair tested
+		float sleepTime = 0.0f; // How long the body has been resting
+		float restitution = 0.9f; // Share of the approach speed kept after a bounce
+		uint32_t category = 1; // Bit of the layer the body is in
+		uint32_t mask = ~0u; // Layers the body collides with, see CollisionFilter
+		glm::vec2 velocity = glm::vec2(0);
+		glm::vec2 oldPosition = glm::vec2(0);
+	};
+
+	///
+	/// \brief Corners of the box in world space, first corner repeated to close the line loop.
+	///
+	std::array<glm::vec2, 5> getVertices(const Box& box, float scale);
+
+	///
+	/// \brief Same as getVertices(box, 1), but cached in the box. Static boxes never recompute them.
+	/// Modifies the cache, so do not call it for the same box from several threads.
+	///
+	const std::array<glm::vec2, 5>& getWorldVertices(Box& box);
+
+	///
+	/// \brief World space bounds, rotation included.
+	///
+	AABB getAABB(const Box& box);
+	AABB getAABB(const Sphere& sphere);
+
+	///
+	/// \brief Mass from the area of the shape, every body has density 1.
+	///
+	float getMass(const Box& box);
+	float getMass(const Sphere& sphere);
+}
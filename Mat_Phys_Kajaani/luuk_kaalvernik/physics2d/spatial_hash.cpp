@@ -0,0 +1,121 @@
+#include <physics2d/spatial_hash.h>
+#include <algorithm>
+#include <cmath>
+
+namespace physics2d {
+	SpatialHash::SpatialHash(float cellSize) {
+		setCellSize(cellSize);
+	}
+
+	void SpatialHash::setCellSize(float cellSize) {
+		m_cellSize = cellSize;
+		m_invCellSize = 1.0f / cellSize;
+	}
+
+	int32_t SpatialHash::toCell(float v) const {
+		return int32_t(std::floor(v * m_invCellSize));
+	}
+
+	uint32_t SpatialHash::bucketOf(int32_t cellX, int32_t cellY) const {
+		// Large primes from Teschner et al. "Optimized Spatial Hashing for Collision Detection"
+		uint32_t h = (uint32_t(cellX) * 73856093u) ^ (uint32_t(cellY) * 19349663u);
+		return h & m_bucketMask;
+	}
+
+	void SpatialHash::update(const std::vector<AABB>& bounds, const std::vector<bool>& isStatic, const std::vector<CollisionFilter>& filters) {
+		m_filters = filters;
+		m_bounds = bounds;
+		m_isStatic = isStatic;
+
+		// Collect (cell, proxy) entries for every cell touched by every proxy
+		m_scratch.clear();
+		for (uint32_t i = 0; i < uint32_t(bounds.size()); ++i)
+		{
+			int32_t x0 = toCell(bounds[i].min.x);
+			int32_t y0 = toCell(bounds[i].min.y);
+			int32_t x1 = toCell(bounds[i].max.x);
+			int32_t y1 = toCell(bounds[i].max.y);
+			for (int32_t y = y0; y <= y1; ++y)
+			{
+				for (int32_t x = x0; x <= x1; ++x)
+				{
+					m_scratch.push_back({ x, y, i });
+				}
+			}
+		}
+
+		// Power of two bucket count, roughly twice the number of entries
+		uint32_t bucketCount = 16;
+		while (bucketCount < 2 * m_scratch.size())
+		{
+			bucketCount *= 2;
+		}
+		m_bucketMask = bucketCount - 1;
+
+		// Counting sort entries by bucket. This is linear and keeps proxies of a
+		// bucket in ascending order, so the pair output is deterministic.
+		m_bucketStart.assign(bucketCount + 1, 0);
+		for (const auto& e : m_scratch)
+		{
+			++m_bucketStart[bucketOf(e.cellX, e.cellY) + 1];
+		}
+		for (uint32_t i = 0; i < bucketCount; ++i)
+		{
+			m_bucketStart[i + 1] += m_bucketStart[i];
+		}
+
+		m_entries.resize(m_scratch.size());
+		m_cursor.assign(m_bucketStart.begin(), m_bucketStart.end() - 1);
+		for (const auto& e : m_scratch)
+		{
+			m_entries[m_cursor[bucketOf(e.cellX, e.cellY)]++] = e;
+		}
+	}
+
+	void SpatialHash::findPairs(std::vector<ProxyPair>& pairs) const {
+		if (m_bucketStart.empty())
+		{
+			return;
+		}
+		const uint32_t bucketCount = uint32_t(m_bucketStart.size()) - 1;
+		for (uint32_t bucket = 0; bucket < bucketCount; ++bucket)
+		{
+			const uint32_t begin = m_bucketStart[bucket];
+			const uint32_t end = m_bucketStart[bucket + 1];
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const Entry& ea = m_entries[i];
+				for (uint32_t j = i + 1; j < end; ++j)
+				{
+					const Entry& eb = m_entries[j];
+					// Different cells may hash into the same bucket
+					if (ea.cellX != eb.cellX || ea.cellY != eb.cellY)
+					{
+						continue;
+					}
+
+					if ((m_isStatic[ea.proxy] && m_isStatic[eb.proxy]) || !shouldCollide(m_filters, ea.proxy, eb.proxy))
+					{
+						continue;
+					}
+
+					const AABB& a = m_bounds[ea.proxy];
+					const AABB& b = m_bounds[eb.proxy];
+					if (!overlaps(a, b))
+					{
+						continue;
+					}
+
+					// Report the pair only from the cell owning the overlap min corner
+					glm::vec2 corner = glm::max(a.min, b.min);
+					if (toCell(corner.x) != ea.cellX || toCell(corner.y) != ea.cellY)
+					{
+						continue;
+					}
+
+					pairs.push_back({ std::min(ea.proxy, eb.proxy), std::max(ea.proxy, eb.proxy) });
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <physics2d/aabb.h>
+#include <physics2d/memory_usage.h>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Uniform grid broadphase backed by a hash table of cells.
+	///
+	/// Every proxy is inserted into each cell its AABB touches. Pairs are only
+	/// generated between proxies sharing a cell, and each pair is reported once
+	/// from the cell that holds the min corner of the pair's overlap region.
+	///
+	class SpatialHash {
+	public:
+		explicit SpatialHash(float cellSize = 2.0f);
+
+		void setCellSize(float cellSize);
+		float getCellSize() const { return m_cellSize; }
+
+		///
+		/// \brief Rebuilds the grid. Proxy ids are indices into bounds.
+		/// Pairs where both proxies are static, or whose filters reject each other, are never reported.
+		///
+		void update(const std::vector<AABB>& bounds, const std::vector<bool>& isStatic, const std::vector<CollisionFilter>& filters = {});
+
+		///
+		/// \brief Appends every overlapping proxy pair to pairs.
+		///
+		void findPairs(std::vector<ProxyPair>& pairs) const;
+
+		size_t getMemoryUsage() const {
+			return physics2d::getMemoryUsage(m_bounds, m_isStatic, m_filters, m_entries, m_bucketStart, m_cursor, m_scratch);
+		}
+
+	private:
+		struct Entry {
+			int32_t cellX;
+			int32_t cellY;
+			uint32_t proxy;
+		};
+
+		int32_t toCell(float v) const;
+		uint32_t bucketOf(int32_t cellX, int32_t cellY) const;
+
+		float m_cellSize;
+		float m_invCellSize;
+		uint32_t m_bucketMask = 0;
+		std::vector<AABB> m_bounds;
+		std::vector<bool> m_isStatic;
+		std::vector<CollisionFilter> m_filters;
+		// Entries sorted by bucket, m_bucketStart[i]..m_bucketStart[i+1] is bucket i.
+		std::vector<Entry> m_entries;
+		std::vector<uint32_t> m_bucketStart;
+		std::vector<uint32_t> m_cursor;
+		std::vector<Entry> m_scratch;
+	};
+}
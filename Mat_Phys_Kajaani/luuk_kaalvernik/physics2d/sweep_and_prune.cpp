@@ -0,0 +1,109 @@
+#include <physics2d/sweep_and_prune.h>
+#include <algorithm>
+
+namespace physics2d {
+	void SweepAndPrune::update(const std::vector<AABB>& bounds, const std::vector<bool>& isStatic, const std::vector<CollisionFilter>& filters) {
+		m_filters = filters;
+		const bool sameProxies = bounds.size() == m_bounds.size();
+		m_bounds = bounds;
+		m_isStatic = isStatic;
+
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			if (sameProxies)
+			{
+				refresh(axis);
+			}
+			else
+			{
+				rebuild(axis);
+			}
+		}
+
+		// Sweep along the axis with the largest variance of box centers
+		glm::vec2 sum(0.0f);
+		glm::vec2 sumSq(0.0f);
+		for (const auto& aabb : m_bounds)
+		{
+			glm::vec2 c = 0.5f * (aabb.min + aabb.max);
+			sum += c;
+			sumSq += c * c;
+		}
+		float n = float(std::max<size_t>(m_bounds.size(), 1));
+		glm::vec2 variance = sumSq / n - (sum / n) * (sum / n);
+		m_sweepAxis = variance.y > variance.x ? 1 : 0;
+	}
+
+	void SweepAndPrune::rebuild(int axis) {
+		auto& endpoints = m_endpoints[axis];
+		endpoints.clear();
+		for (uint32_t i = 0; i < uint32_t(m_bounds.size()); ++i)
+		{
+			endpoints.push_back({ m_bounds[i].min[axis], i, 0 });
+			endpoints.push_back({ m_bounds[i].max[axis], i, 1 });
+		}
+		std::sort(endpoints.begin(), endpoints.end());
+	}
+
+	void SweepAndPrune::refresh(int axis) {
+		auto& endpoints = m_endpoints[axis];
+		for (auto& e : endpoints)
+		{
+			const AABB& aabb = m_bounds[e.proxy];
+			e.value = e.isMax ? aabb.max[axis] : aabb.min[axis];
+		}
+		insertionSort(endpoints);
+	}
+
+	void SweepAndPrune::insertionSort(std::vector<Endpoint>& endpoints) {
+		for (size_t i = 1; i < endpoints.size(); ++i)
+		{
+			Endpoint key = endpoints[i];
+			size_t j = i;
+			while (j > 0 && key < endpoints[j - 1])
+			{
+				endpoints[j] = endpoints[j - 1];
+				--j;
+			}
+			endpoints[j] = key;
+		}
+	}
+
+	void SweepAndPrune::findPairs(std::vector<ProxyPair>& pairs) const {
+		const int other = 1 - m_sweepAxis;
+		m_active.clear();
+		m_activeIndex.resize(m_bounds.size());
+
+		for (const auto& e : m_endpoints[m_sweepAxis])
+		{
+			if (e.isMax)
+			{
+				// Swap remove from the active list
+				uint32_t index = m_activeIndex[e.proxy];
+				uint32_t last = m_active.back();
+				m_active[index] = last;
+				m_activeIndex[last] = index;
+				m_active.pop_back();
+				continue;
+			}
+
+			// Every active proxy overlaps e.proxy on the sweep axis, test the other one
+			const AABB& a = m_bounds[e.proxy];
+			const bool isStatic = m_isStatic[e.proxy];
+			for (uint32_t proxy : m_active)
+			{
+				if ((isStatic && m_isStatic[proxy]) || !shouldCollide(m_filters, proxy, e.proxy))
+				{
+					continue;
+				}
+				const AABB& b = m_bounds[proxy];
+				if (a.min[other] <= b.max[other] && b.min[other] <= a.max[other])
+				{
+					pairs.push_back({ std::min(proxy, e.proxy), std::max(proxy, e.proxy) });
+				}
+			}
+			m_activeIndex[e.proxy] = uint32_t(m_active.size());
+			m_active.push_back(e.proxy);
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <physics2d/aabb.h>
+#include <physics2d/memory_usage.h>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Incremental sweep and prune broadphase.
+	///
+	/// The min/max endpoints of all proxies are kept sorted on both axes across
+	/// updates. Bodies move only a little between frames, so the arrays are nearly
+	/// sorted and insertion sort fixes them in close to linear time. Pairs are then
+	/// found with a single sweep over the axis where the bodies are most spread out.
+	///
+	class SweepAndPrune {
+	public:
+		///
+		/// \brief Updates endpoints from bounds. Proxy ids are indices into bounds.
+		/// Changing the number of proxies rebuilds the endpoint arrays from scratch.
+		/// Pairs where both proxies are static, or whose filters reject each other, are never reported.
+		///
+		void update(const std::vector<AABB>& bounds, const std::vector<bool>& isStatic, const std::vector<CollisionFilter>& filters = {});
+
+		///
+		/// \brief Appends every overlapping proxy pair to pairs.
+		///
+		void findPairs(std::vector<ProxyPair>& pairs) const;
+
+		size_t getMemoryUsage() const {
+			return physics2d::getMemoryUsage(m_bounds, m_isStatic, m_filters, m_endpoints[0], m_endpoints[1], m_active, m_activeIndex);
+		}
+
+	private:
+		struct Endpoint {
+			float value;
+			uint32_t proxy;
+			uint32_t isMax;
+
+			// Min endpoints sort before max endpoints at the same value, so touching counts as overlap
+			bool operator<(const Endpoint& other) const {
+				return value < other.value || (value == other.value && isMax < other.isMax);
+			}
+		};
+
+		void rebuild(int axis);
+		void refresh(int axis);
+		static void insertionSort(std::vector<Endpoint>& endpoints);
+
+		std::vector<AABB> m_bounds;
+		std::vector<bool> m_isStatic;
+		std::vector<CollisionFilter> m_filters;
+		std::vector<Endpoint> m_endpoints[2];
+		int m_sweepAxis = 0;
+		mutable std::vector<uint32_t> m_active;
+		mutable std::vector<uint32_t> m_activeIndex;
+	};
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <physics2d/aabb.h>
+#include <physics2d/contact.h>
+#include <physics2d/contact_solver.h>
+#include <algorithm>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Stops bodies where they would first touch another body during this step.
+	///
+	/// Pairs with a contact are handled by the solver and skipped, contacts must come in
+	/// pair order as the narrowphase makes them. The rest were apart by more than margin,
+	/// so only pairs closing in faster than that are swept. A body in several pairs moves
+	/// by the smallest time of impact of them, and static bodies are never scaled.
+	/// Stopped bodies keep their velocity, next step's contact takes care of it.
+	///
+	/// \param sweep = bool(const ProxyPair&, const glm::vec2& displacement, float& toi), displacement
+	/// is the movement of pair.a relative to pair.b, toi the share of it before they touch
+	/// \param timeOfImpact = scratch, ends up with the share of its displacement each body moved
+	/// \return number of bodies stopped early
+	///
+	template<typename SweepFunc>
+	uint32_t solveTimeOfImpact(const std::vector<ProxyPair>& pairs, const std::vector<Contact>& contacts, float margin,
+		SweepFunc sweep, std::vector<SolverBody>& bodies, std::vector<float>& timeOfImpact) {
+		timeOfImpact.assign(bodies.size(), 1.0f);
+		size_t nextContact = 0;
+		for (const auto& pair : pairs)
+		{
+			if (nextContact < contacts.size() && contacts[nextContact].a == pair.a && contacts[nextContact].b == pair.b)
+			{
+				++nextContact;
+				continue;
+			}
+			const glm::vec2 displacement = bodies[pair.a].displacement - bodies[pair.b].displacement;
+			if (glm::dot(displacement, displacement) <= margin * margin)
+			{
+				continue;
+			}
+			float toi;
+			if (sweep(pair, displacement, toi))
+			{
+				timeOfImpact[pair.a] = std::min(timeOfImpact[pair.a], toi);
+				timeOfImpact[pair.b] = std::min(timeOfImpact[pair.b], toi);
+			}
+		}
+
+		// Scaled only after every pair is swept, so each sweep sees the full displacements
+		uint32_t stopped = 0;
+		for (size_t i = 0; i < bodies.size(); ++i)
+		{
+			if (timeOfImpact[i] < 1.0f && bodies[i].inverseMass > 0.0f)
+			{
+				bodies[i].displacement *= timeOfImpact[i];
+				++stopped;
+			}
+		}
+		return stopped;
+	}
+}
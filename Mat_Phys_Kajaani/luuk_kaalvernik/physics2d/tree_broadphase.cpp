@@ -0,0 +1,116 @@
+#include <physics2d/tree_broadphase.h>
+#include <algorithm>
+
+namespace physics2d {
+	TreeBroadphase::TreeBroadphase(float margin)
+		: m_staticTree(0.0f)
+		, m_dynamicTree(margin) {
+	}
+
+	void TreeBroadphase::rebuild() {
+		m_dynamicProxies.clear();
+		std::vector<AABB> staticBounds;
+		std::vector<uint32_t> staticProxies;
+		for (uint32_t i = 0; i < uint32_t(m_bounds.size()); ++i)
+		{
+			if (m_isStatic[i])
+			{
+				staticProxies.push_back(i);
+				staticBounds.push_back(m_bounds[i]);
+			}
+			else
+			{
+				m_dynamicProxies.push_back(i);
+			}
+		}
+		std::vector<int32_t> staticLeaves = m_staticTree.build(staticBounds, staticProxies);
+
+		m_dynamicTree.clear();
+		m_leaves.assign(m_bounds.size(), AABBTree::NullNode);
+		for (size_t i = 0; i < staticProxies.size(); ++i)
+		{
+			m_leaves[staticProxies[i]] = staticLeaves[i];
+		}
+		for (uint32_t proxy : m_dynamicProxies)
+		{
+			m_leaves[proxy] = m_dynamicTree.createProxy(m_bounds[proxy], proxy);
+		}
+	}
+
+	void TreeBroadphase::update(const std::vector<AABB>& bounds, const std::vector<bool>& isStatic, const std::vector<CollisionFilter>& filters) {
+		m_filters = filters;
+		if (bounds.size() != m_bounds.size())
+		{
+			m_bounds = bounds;
+			m_isStatic = isStatic;
+			rebuild();
+			return;
+		}
+
+		bool membershipChanged = false;
+		for (uint32_t i = 0; i < uint32_t(bounds.size()); ++i)
+		{
+			const AABB& oldBounds = m_bounds[i];
+			const AABB& newBounds = bounds[i];
+			if (isStatic[i] != m_isStatic[i])
+			{
+				AABBTree& from = m_isStatic[i] ? m_staticTree : m_dynamicTree;
+				AABBTree& to = isStatic[i] ? m_staticTree : m_dynamicTree;
+				from.destroyProxy(m_leaves[i]);
+				m_leaves[i] = to.createProxy(newBounds, i);
+				m_isStatic[i] = isStatic[i];
+				membershipChanged = true;
+			}
+			else if (m_isStatic[i])
+			{
+				// Static bodies are not expected to move, but if one did the tree has to follow
+				if (newBounds.min != oldBounds.min || newBounds.max != oldBounds.max)
+				{
+					m_staticTree.destroyProxy(m_leaves[i]);
+					m_leaves[i] = m_staticTree.createProxy(newBounds, i);
+				}
+			}
+			else
+			{
+				glm::vec2 displacement = 0.5f * ((newBounds.min + newBounds.max) - (oldBounds.min + oldBounds.max));
+				m_dynamicTree.moveProxy(m_leaves[i], newBounds, displacement);
+			}
+		}
+		m_bounds = bounds;
+
+		if (membershipChanged)
+		{
+			m_dynamicProxies.clear();
+			for (uint32_t i = 0; i < uint32_t(m_bounds.size()); ++i)
+			{
+				if (!m_isStatic[i])
+				{
+					m_dynamicProxies.push_back(i);
+				}
+			}
+		}
+	}
+
+	void TreeBroadphase::findPairs(std::vector<ProxyPair>& pairs) const {
+		// Dynamic vs dynamic: fat leaves overlap, confirm with the tight bounds
+		m_dynamicTree.queryPairs([&](uint32_t a, uint32_t b) {
+			if (shouldCollide(m_filters, a, b) && overlaps(m_bounds[a], m_bounds[b]))
+			{
+				pairs.push_back({ std::min(a, b), std::max(a, b) });
+			}
+		});
+
+		// Dynamic vs static
+		for (uint32_t proxy : m_dynamicProxies)
+		{
+			const AABB& aabb = m_bounds[proxy];
+			m_staticTree.query(aabb, [&](uint32_t other) {
+				if (shouldCollide(m_filters, proxy, other) && overlaps(m_bounds[other], aabb))
+				{
+					pairs.push_back({ std::min(proxy, other), std::max(proxy, other) });
+				}
+				return true;
+			});
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <physics2d/aabb_tree.h>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Broadphase made of two AABB trees.
+	///
+	/// Static proxies go into a tree that is built once top-down, dynamic proxies
+	/// into a tree with fattened leaves that is refitted incrementally. Pairs are
+	/// dynamic vs dynamic and dynamic vs static, static vs static is never tested.
+	/// Works well for big static walls mixed with many small moving bodies.
+	///
+	class TreeBroadphase {
+	public:
+		///
+		/// \brief margin = How much dynamic leaves are fattened on each side.
+		///
+		explicit TreeBroadphase(float margin = 0.1f);
+
+		///
+		/// \brief Updates proxies from bounds. Proxy ids are indices into bounds.
+		/// Changing the number of proxies rebuilds both trees. A proxy that turns
+		/// static or dynamic, like a body falling asleep, only moves to the other tree.
+		/// Pairs whose filters reject each other are never reported.
+		///
+		void update(const std::vector<AABB>& bounds, const std::vector<bool>& isStatic, const std::vector<CollisionFilter>& filters = {});
+
+		///
+		/// \brief Appends every overlapping proxy pair to pairs.
+		///
+		void findPairs(std::vector<ProxyPair>& pairs) const;
+
+		size_t getMemoryUsage() const {
+			return m_staticTree.getMemoryUsage() + m_dynamicTree.getMemoryUsage()
+				+ physics2d::getMemoryUsage(m_bounds, m_isStatic, m_filters, m_dynamicProxies, m_leaves);
+		}
+
+		///
+		/// \brief Calls callback(proxy) for every proxy whose bounds overlap aabb.
+		///
+		template<typename Callback>
+		void query(const AABB& aabb, Callback callback) const;
+
+		///
+		/// \brief Calls callback(proxy) for every proxy whose bounds contain point.
+		///
+		template<typename Callback>
+		void queryPoint(const glm::vec2& point, Callback callback) const;
+
+		const AABBTree& getStaticTree() const { return m_staticTree; }
+		const AABBTree& getDynamicTree() const { return m_dynamicTree; }
+
+	private:
+		void rebuild();
+
+		AABBTree m_staticTree;
+		AABBTree m_dynamicTree;
+		std::vector<AABB> m_bounds;
+		std::vector<bool> m_isStatic;
+		std::vector<CollisionFilter> m_filters;
+		std::vector<uint32_t> m_dynamicProxies;
+		std::vector<int32_t> m_leaves; // Proxy -> leaf node in the tree it belongs to
+	};
+
+	template<typename Callback>
+	void TreeBroadphase::query(const AABB& aabb, Callback callback) const {
+		m_staticTree.query(aabb, [&](uint32_t proxy) {
+			if (overlaps(m_bounds[proxy], aabb))
+			{
+				callback(proxy);
+			}
+			return true;
+		});
+		m_dynamicTree.query(aabb, [&](uint32_t proxy) {
+			if (overlaps(m_bounds[proxy], aabb))
+			{
+				callback(proxy);
+			}
+			return true;
+		});
+	}
+
+	template<typename Callback>
+	void TreeBroadphase::queryPoint(const glm::vec2& point, Callback callback) const {
+		query({ point, point }, callback);
+	}
+}
@@ -0,0 +1,391 @@
+#include <physics2d/world.h>
+#include <physics2d/collision.h>
+#include <physics2d/profiler.h>
+#include <physics2d/time_of_impact.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+namespace physics2d {
+	namespace {
+		using Clock = std::chrono::steady_clock;
+
+		double secondsSince(Clock::time_point start) {
+			return std::chrono::duration<double>(Clock::now() - start).count();
+		}
+	}
+
+	World::World(const WorldSettings& settings)
+		: m_settings(settings)
+		, m_spatialHash(settings.cellSize)
+		, m_jobs(settings.threadCount)
+		, m_narrowphase(m_jobs)
+		, m_solver(m_jobs) {
+	}
+
+	void World::step(float deltaTime) {
+		m_stats = StepStats();
+
+		// Adding or removing bodies shifts proxy ids, which invalidates the sleeping islands and cached contacts
+		if (boxes.size() + spheres.size() != m_bodyCount)
+		{
+			wakeAll();
+			m_contactCache.clear();
+		}
+
+		// Stages run as jobs after the stages they depend on, and spread their own work over the job system.
+		// Moving the bodies and putting them to sleep touch different data, so they run side by side.
+		using JobHandle = JobSystem::JobHandle;
+		auto stage = [&](double& time, std::function<void()> function, const std::vector<JobHandle>& dependencies) {
+			return m_jobs.submit([&time, function] {
+				auto start = Clock::now();
+				function();
+				time += secondsSince(start);
+			}, dependencies);
+		};
+		JobHandle integrate = stage(m_stats.integrate, [&] { integrateVelocities(deltaTime); }, {});
+		JobHandle broadphase = stage(m_stats.broadphase, [&] { updateBroadphase(deltaTime); }, { integrate });
+		JobHandle narrowphase = stage(m_stats.narrowphase, [&] { detectCollisions(); }, { broadphase });
+		JobHandle response = stage(m_stats.response, [&] {
+			wakeTouchedIslands();
+			solveContacts(deltaTime);
+			if (m_settings.continuousCollision)
+			{
+				solveTimeOfImpact();
+			}
+		}, { narrowphase });
+		JobHandle move = stage(m_stats.integrate, [&] { integratePositions(); }, { response });
+		JobHandle sleep = stage(m_stats.response, [&] { updateSleeping(deltaTime); }, { response });
+		m_jobs.wait(move);
+		m_jobs.wait(sleep);
+
+		m_stats.pairTests = uint32_t(m_pairs.size());
+		m_stats.contacts = uint32_t(m_contacts.size());
+	}
+
+	size_t World::getMemoryUsage() const {
+		return m_spatialHash.getMemoryUsage() + m_sweepAndPrune.getMemoryUsage() + m_tree.getMemoryUsage()
+			+ m_narrowphase.getMemoryUsage() + m_contactCache.getMemoryUsage() + m_solver.getMemoryUsage()
+			+ physics2d::getMemoryUsage(boxes, spheres, m_bounds, m_isStatic, m_filters, m_pairs, m_contacts, m_solverBodies, m_timeOfImpact)
+			+ physics2d::getMemoryUsage(m_awake, m_islandParent, m_islandRestTime, m_rootToSleeping, m_sleepingIsland, m_sleepingIslands, m_freeIslands);
+	}
+
+	void World::integrateVelocities(float deltaTime) {
+		PHYSICS2D_PROFILE_ZONE("integrate");
+		const glm::vec2 dv = m_settings.gravity * deltaTime;
+		forEachBody([&](uint32_t, auto& obj) {
+			if (!obj.isStatic && !obj.isSleeping)
+			{
+				obj.velocity += dv;
+			}
+		});
+	}
+
+	void World::integratePositions() {
+		PHYSICS2D_PROFILE_ZONE("integrate");
+		// Displacements come from the solver: velocity * deltaTime plus penetration correction
+		forEachBody([&](uint32_t proxy, auto& obj) {
+			obj.oldPosition = obj.position;
+			obj.position += m_solverBodies[proxy].displacement;
+		});
+	}
+
+	void World::updateBroadphase(float deltaTime) {
+		PHYSICS2D_PROFILE_ZONE("broadphase");
+		// Grown by half the contact margin, so bodies within the margin of each other are paired.
+		// Fast bodies cover their whole path, so they are paired with everything they may pass.
+		const float margin = m_settings.contactMargin;
+		const glm::vec2 grow(0.5f * margin);
+		const bool sweep = m_settings.continuousCollision;
+		m_bounds.clear();
+		m_isStatic.clear();
+		m_filters.clear();
+		auto add = [&](const auto& obj, AABB aabb) {
+			glm::vec2 displacement = obj.velocity * deltaTime;
+			if (sweep && glm::dot(displacement, displacement) > margin * margin)
+			{
+				aabb = combine(aabb, { aabb.min + displacement, aabb.max + displacement });
+			}
+			m_bounds.push_back({ aabb.min - grow, aabb.max + grow });
+			m_isStatic.push_back(obj.isStatic || obj.isSleeping);
+			m_filters.push_back({ obj.category, obj.mask });
+		};
+		for (const auto& box : boxes)
+		{
+			add(box, getAABB(box));
+		}
+		for (const auto& sphere : spheres)
+		{
+			add(sphere, getAABB(sphere));
+		}
+
+		m_pairs.clear();
+		switch (m_settings.broadphase)
+		{
+		case BroadphaseType::SpatialHash:
+			m_spatialHash.update(m_bounds, m_isStatic, m_filters);
+			m_spatialHash.findPairs(m_pairs);
+			break;
+		case BroadphaseType::SweepAndPrune:
+			m_sweepAndPrune.update(m_bounds, m_isStatic, m_filters);
+			m_sweepAndPrune.findPairs(m_pairs);
+			break;
+		case BroadphaseType::Tree:
+			m_tree.update(m_bounds, m_isStatic, m_filters);
+			m_tree.findPairs(m_pairs);
+			break;
+		}
+	}
+
+	void World::detectCollisions() {
+		PHYSICS2D_PROFILE_ZONE("narrowphase");
+		// Bodies are only read here, so pairs can be tested in parallel
+		const uint32_t numBoxes = uint32_t(boxes.size());
+		const float margin = m_settings.contactMargin;
+		m_narrowphase.detect(m_pairs, [&](const ProxyPair& pair, Contact& contact) {
+			if (pair.b < numBoxes)
+			{
+				return collideBoxes(boxes[pair.a], boxes[pair.b], margin, contact);
+			}
+			if (pair.a >= numBoxes)
+			{
+				return collideSpheres(spheres[pair.a - numBoxes], spheres[pair.b - numBoxes], margin, contact);
+			}
+			// Boxes come first, so a is the box and b the sphere
+			return collideBoxSphere(boxes[pair.a], spheres[pair.b - numBoxes], margin, contact);
+		}, m_contacts);
+
+		m_contactCache.warmStart(m_contacts);
+	}
+
+	void World::solveTimeOfImpact() {
+		PHYSICS2D_PROFILE_ZONE("time of impact");
+		const uint32_t numBoxes = uint32_t(boxes.size());
+		auto sweep = [&](const ProxyPair& pair, const glm::vec2& displacement, float& toi) {
+			// Rotated boxes are swept as their bounds, which only makes them stop a bit early
+			if (pair.b < numBoxes)
+			{
+				return sweepAABB(getAABB(boxes[pair.a]), displacement, getAABB(boxes[pair.b]), toi);
+			}
+			if (pair.a >= numBoxes)
+			{
+				const Sphere& a = spheres[pair.a - numBoxes];
+				const Sphere& b = spheres[pair.b - numBoxes];
+				return sweepCircles(a.position, a.radius, displacement, b.position, b.radius, toi);
+			}
+			const Sphere& b = spheres[pair.b - numBoxes];
+			return sweepCircleAABB(b.position, b.radius, -displacement, getAABB(boxes[pair.a]), toi);
+		};
+		m_stats.timeOfImpacts += physics2d::solveTimeOfImpact(m_pairs, m_contacts, m_settings.contactMargin, sweep, m_solverBodies, m_timeOfImpact);
+	}
+
+	void World::solveContacts(float deltaTime) {
+		PHYSICS2D_PROFILE_ZONE("solve contacts");
+		// Velocities in proxy order for the solver
+		m_solverBodies.clear();
+		auto gather = [&](auto& objects) {
+			for (auto& obj : objects)
+			{
+				obj.isColliding = false;
+				float inverseMass = obj.isStatic || obj.isSleeping ? 0.0f : 1.0f / getMass(obj);
+				m_solverBodies.push_back({ obj.velocity, glm::vec2(0), inverseMass, obj.restitution });
+			}
+		};
+		gather(boxes);
+		gather(spheres);
+
+		// Colors are solved in order, so results do not depend on thread count
+		SolverSettings solverSettings = m_settings.solver;
+		solverSettings.gravity = m_settings.gravity;
+		m_solver.solveVelocities(m_contacts, m_solverBodies, solverSettings, deltaTime);
+		m_contactCache.store(m_contacts);
+		for (auto& body : m_solverBodies)
+		{
+			if (body.inverseMass > 0.0f)
+			{
+				body.displacement = body.velocity * deltaTime;
+			}
+		}
+		m_solver.solvePositions(m_solverBodies, solverSettings);
+
+		const uint32_t numBoxes = uint32_t(boxes.size());
+		for (uint32_t i = 0; i < numBoxes; ++i)
+		{
+			boxes[i].velocity = m_solverBodies[i].velocity;
+		}
+		for (uint32_t i = 0; i < uint32_t(spheres.size()); ++i)
+		{
+			spheres[i].velocity = m_solverBodies[numBoxes + i].velocity;
+		}
+		for (const auto& contact : m_contacts)
+		{
+			// Contacts within the margin do not count as touching yet
+			bool touching = false;
+			for (uint32_t i = 0; i < contact.pointCount; ++i)
+			{
+				touching |= contact.points[i].depth >= 0.0f;
+			}
+			if (touching)
+			{
+				visitBody(contact.a, [](auto& body) { body.isColliding = true; });
+				visitBody(contact.b, [](auto& body) { body.isColliding = true; });
+			}
+		}
+	}
+
+	void World::wakeTouchedIslands() {
+		PHYSICS2D_PROFILE_ZONE("sleeping");
+		if (!m_settings.allowSleeping)
+		{
+			return;
+		}
+
+		// Broadphase never pairs two sleeping bodies, so a contact with a sleeping
+		// body means something awake touched it
+		for (const auto& contact : m_contacts)
+		{
+			for (uint32_t proxy : { contact.a, contact.b })
+			{
+				if (m_sleepingIsland[proxy] != NoIsland)
+				{
+					wake(proxy);
+				}
+			}
+		}
+	}
+
+	void World::updateSleeping(float deltaTime) {
+		PHYSICS2D_PROFILE_ZONE("sleeping");
+		if (!m_settings.allowSleeping)
+		{
+			return;
+		}
+		const uint32_t count = uint32_t(m_bodyCount);
+
+		// Rest timers, and every awake body starts as an island of its own
+		const float sleepVelocity2 = m_settings.sleepVelocity * m_settings.sleepVelocity;
+		m_islandParent.resize(count);
+		m_islandRestTime.resize(count);
+		m_rootToSleeping.resize(count);
+		m_awake.clear();
+		auto addAwake = [&](auto& body, uint32_t proxy) {
+			if (body.isStatic || body.isSleeping)
+			{
+				m_islandParent[proxy] = NoIsland;
+				return;
+			}
+			body.sleepTime = glm::dot(body.velocity, body.velocity) < sleepVelocity2 ? body.sleepTime + deltaTime : 0.0f;
+			m_islandParent[proxy] = proxy;
+			m_islandRestTime[proxy] = FLT_MAX;
+			m_rootToSleeping[proxy] = NoIsland;
+			m_awake.push_back(proxy);
+		};
+		const uint32_t numBoxes = uint32_t(boxes.size());
+		for (uint32_t i = 0; i < numBoxes; ++i)
+		{
+			addAwake(boxes[i], i);
+		}
+		for (uint32_t i = 0; i < uint32_t(spheres.size()); ++i)
+		{
+			addAwake(spheres[i], numBoxes + i);
+		}
+
+		// Bodies touching each other share an island, static bodies do not join islands
+		for (const auto& contact : m_contacts)
+		{
+			if (m_islandParent[contact.a] != NoIsland && m_islandParent[contact.b] != NoIsland)
+			{
+				m_islandParent[findIsland(contact.a)] = findIsland(contact.b);
+			}
+		}
+
+		// An island rests as long as its most restless body
+		for (uint32_t proxy : m_awake)
+		{
+			visitBody(proxy, [&](const auto& body) {
+				float& restTime = m_islandRestTime[findIsland(proxy)];
+				restTime = std::min(restTime, body.sleepTime);
+			});
+		}
+
+		for (uint32_t proxy : m_awake)
+		{
+			uint32_t root = findIsland(proxy);
+			if (m_islandRestTime[root] < m_settings.timeToSleep)
+			{
+				continue;
+			}
+			uint32_t& island = m_rootToSleeping[root];
+			if (island == NoIsland)
+			{
+				if (m_freeIslands.empty())
+				{
+					island = uint32_t(m_sleepingIslands.size());
+					m_sleepingIslands.emplace_back();
+				}
+				else
+				{
+					island = m_freeIslands.back();
+					m_freeIslands.pop_back();
+				}
+			}
+			m_sleepingIslands[island].push_back(proxy);
+			m_sleepingIsland[proxy] = island;
+			++m_sleepingCount;
+			visitBody(proxy, [](auto& body) {
+				body.isSleeping = true;
+				body.velocity = glm::vec2(0);
+			});
+		}
+		m_stats.sleepingBodies = m_sleepingCount;
+	}
+
+	uint32_t World::findIsland(uint32_t proxy) {
+		while (m_islandParent[proxy] != proxy)
+		{
+			m_islandParent[proxy] = m_islandParent[m_islandParent[proxy]];
+			proxy = m_islandParent[proxy];
+		}
+		return proxy;
+	}
+
+	void World::wake(uint32_t proxy) {
+		auto wakeBody = [](auto& body) {
+			body.isSleeping = false;
+			body.sleepTime = 0.0f;
+		};
+		if (proxy >= m_sleepingIsland.size() || m_sleepingIsland[proxy] == NoIsland)
+		{
+			visitBody(proxy, wakeBody);
+			return;
+		}
+
+		uint32_t island = m_sleepingIsland[proxy];
+		for (uint32_t member : m_sleepingIslands[island])
+		{
+			visitBody(member, wakeBody);
+			m_sleepingIsland[member] = NoIsland;
+		}
+		m_sleepingCount -= uint32_t(m_sleepingIslands[island].size());
+		m_sleepingIslands[island].clear();
+		m_freeIslands.push_back(island);
+	}
+
+	void World::wakeAll() {
+		m_bodyCount = boxes.size() + spheres.size();
+		for (auto& box : boxes)
+		{
+			box.isSleeping = false;
+			box.sleepTime = 0.0f;
+		}
+		for (auto& sphere : spheres)
+		{
+			sphere.isSleeping = false;
+			sphere.sleepTime = 0.0f;
+		}
+		m_sleepingIsland.assign(m_bodyCount, NoIsland);
+		m_sleepingIslands.clear();
+		m_freeIslands.clear();
+		m_sleepingCount = 0;
+	}
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include <physics2d/contact_cache.h>
+#include <physics2d/contact_solver.h>
+#include <physics2d/shapes.h>
+#include <physics2d/narrowphase.h>
+#include <physics2d/spatial_hash.h>
+#include <physics2d/sweep_and_prune.h>
+#include <physics2d/tree_broadphase.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace physics2d {
+	enum class BroadphaseType {
+		SpatialHash,
+		SweepAndPrune,
+		Tree,
+	};
+
+	struct WorldSettings {
+		BroadphaseType broadphase = BroadphaseType::Tree;
+		float cellSize = 2.0f; // Only used by the spatial hash
+		uint32_t threadCount = 0; // 0 = number of cores
+		glm::vec2 gravity = glm::vec2(0, -9.81f);
+		float contactMargin = 0.02f; // Bodies closer than this get a contact before they touch
+		// Bodies moving further than contactMargin in a step are swept against what they pass,
+		// and stopped where they first touch instead of tunneling through thin walls
+		bool continuousCollision = true;
+		SolverSettings solver;
+
+		// A body rests while slower than sleepVelocity. Bodies touching each other form an
+		// island, which falls asleep once every body in it has rested for timeToSleep seconds.
+		bool allowSleeping = true;
+		float sleepVelocity = 0.2f;
+		float timeToSleep = 0.5f;
+	};
+
+	///
+	/// \brief Timings in seconds and counters of the last World::step().
+	///
+	struct StepStats {
+		double integrate = 0;
+		double broadphase = 0;
+		double narrowphase = 0;
+		double response = 0;
+		uint32_t pairTests = 0;
+		uint32_t contacts = 0;
+		uint32_t sleepingBodies = 0;
+		uint32_t timeOfImpacts = 0; // Bodies stopped early by continuous collision
+
+		double total() const { return integrate + broadphase + narrowphase + response; }
+	};
+
+	///
+	/// \brief Boxes and spheres stepped together without any window.
+	///
+	/// Proxy ids used by the broadphase and in contacts are box indices first,
+	/// followed by sphere indices offset by the number of boxes.
+	///
+	/// Sleeping bodies are skipped by the integration and handed to the broadphase
+	/// as static, so only awake bodies cost pair tests. An awake body touching a
+	/// sleeping one wakes the whole island the sleeping body fell asleep with.
+	///
+	/// Bodies only collide when the category of each is in the mask of the other.
+	/// The broadphase rejects other pairs before testing their bounds.
+	///
+	class World {
+	public:
+		explicit World(const WorldSettings& settings = WorldSettings());
+
+		///
+		/// \brief Applies gravity, finds contacts, solves them for velocity and then moves the bodies.
+		///
+		void step(float deltaTime);
+
+		///
+		/// \brief Wakes the body and everything it fell asleep with. Call it after
+		/// moving or pushing a body from outside, otherwise a sleeping body ignores it.
+		///
+		void wake(uint32_t proxy);
+
+		const StepStats& getStats() const { return m_stats; }
+		const std::vector<Contact>& getContacts() const { return m_contacts; }
+		JobSystem& getJobSystem() { return m_jobs; }
+
+		///
+		/// \brief Bytes allocated for the bodies and by every stage of the step, broadphases included.
+		///
+		size_t getMemoryUsage() const;
+
+		std::vector<Box> boxes;
+		std::vector<Sphere> spheres;
+
+	private:
+		void integrateVelocities(float deltaTime);
+		void integratePositions();
+		void updateBroadphase(float deltaTime);
+		void detectCollisions();
+		void solveContacts(float deltaTime);
+		void solveTimeOfImpact();
+		void wakeTouchedIslands();
+		void updateSleeping(float deltaTime);
+		void wakeAll();
+		uint32_t findIsland(uint32_t proxy);
+
+		template<typename Function>
+		void visitBody(uint32_t proxy, Function function);
+
+		///
+		/// \brief Calls function(proxy, body) for every body, spread over the job system.
+		///
+		template<typename Function>
+		void forEachBody(Function function);
+
+		WorldSettings m_settings;
+		SpatialHash m_spatialHash;
+		SweepAndPrune m_sweepAndPrune;
+		TreeBroadphase m_tree;
+		JobSystem m_jobs;
+		Narrowphase m_narrowphase;
+		ContactCache m_contactCache;
+		ContactSolver m_solver;
+
+		std::vector<AABB> m_bounds;
+		std::vector<bool> m_isStatic;
+		std::vector<CollisionFilter> m_filters;
+		std::vector<ProxyPair> m_pairs;
+		std::vector<Contact> m_contacts;
+		std::vector<SolverBody> m_solverBodies;
+		std::vector<float> m_timeOfImpact; // Share of its displacement each body may move this step
+		StepStats m_stats;
+
+		static constexpr uint32_t NoIsland = ~0u;
+		size_t m_bodyCount = 0;
+		std::vector<uint32_t> m_awake; // Proxies of the awake dynamic bodies
+		std::vector<uint32_t> m_islandParent; // Union find over this step's contacts
+		std::vector<float> m_islandRestTime; // Shortest rest time of each island root
+		std::vector<uint32_t> m_rootToSleeping;
+		std::vector<uint32_t> m_sleepingIsland; // Proxy -> index into m_sleepingIslands
+		std::vector<std::vector<uint32_t>> m_sleepingIslands; // Proxies of each sleeping island
+		std::vector<uint32_t> m_freeIslands;
+		uint32_t m_sleepingCount = 0;
+
+		static constexpr uint32_t MinBodiesPerJob = 1024;
+	};
+
+	template<typename Function>
+	void World::visitBody(uint32_t proxy, Function function) {
+		if (proxy < boxes.size())
+		{
+			function(boxes[proxy]);
+		}
+		else
+		{
+			function(spheres[proxy - boxes.size()]);
+		}
+	}
+
+	template<typename Function>
+	void World::forEachBody(Function function) {
+		const uint32_t numBoxes = uint32_t(boxes.size());
+		const uint32_t count = numBoxes + uint32_t(spheres.size());
+		m_jobs.wait(m_jobs.parallelFor(count, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t proxy = begin; proxy < std::min(end, numBoxes); ++proxy)
+			{
+				function(proxy, boxes[proxy]);
+			}
+			for (uint32_t proxy = std::max(begin, numBoxes); proxy < end; ++proxy)
+			{
+				function(proxy, spheres[proxy - numBoxes]);
+			}
+		}, {}, MinBodiesPerJob));
+	}
+}
@@ -0,0 +1,242 @@
+#include <physics2d/world.h>
+#include <physics2d/collision.h>
+#include <bench_args.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+// Steps a generated scene without any window and prints how fast it went.
+// Usage: physics_bench [--spheres N] [--boxes N] [--steps N] [--dt S]
+//                      [--broadphase tree|grid|sap] [--threads N] [--seed N] [--sleep 0|1] [--ccd 0|1]
+
+struct BenchSettings {
+	uint32_t spheres = 5000;
+	uint32_t boxes = 500;
+	uint32_t steps = 300;
+	float dt = 1.0f / 60.0f;
+	uint32_t threads = 0;
+	uint32_t seed = 1;
+	bool sleeping = true;
+	bool continuousCollision = true;
+	physics2d::BroadphaseType broadphase = physics2d::BroadphaseType::Tree;
+};
+
+bool parseArgs(int argc, char** argv, BenchSettings& settings) {
+	return physics2d::parseBenchArgs(argc, argv, [&](const std::string& name, const char* value) {
+		if (name == "--spheres") settings.spheres = uint32_t(std::atoi(value));
+		else if (name == "--boxes") settings.boxes = uint32_t(std::atoi(value));
+		else if (name == "--sleep") settings.sleeping = std::atoi(value) != 0;
+		else if (name == "--ccd") settings.continuousCollision = std::atoi(value) != 0;
+		else return physics2d::parseWorldBenchOption(name, value, settings);
+		return true;
+	});
+}
+
+// Random bodies inside an arena closed by four static walls. The arena grows
+// with the body count so the density stays the same for every scene size.
+void createScene(physics2d::World& world, const BenchSettings& settings) {
+	const float size = std::max(10.0f, std::sqrt(float(settings.spheres + settings.boxes)));
+	world.boxes.push_back({ .position = {0, -size}, .halfsize = {size, 0.5f} });
+	world.boxes.push_back({ .position = {-size, 0}, .halfsize = {0.5f, size} });
+	world.boxes.push_back({ .position = {size, 0}, .halfsize = {0.5f, size} });
+	world.boxes.push_back({ .position = {0, size}, .halfsize = {size, 0.5f} });
+	for (auto& wall : world.boxes)
+	{
+		wall.isStatic = true;
+	}
+
+	std::mt19937 rng(settings.seed);
+	std::uniform_real_distribution<float> position(-size + 1.0f, size - 1.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 0.5f);
+	std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+	for (uint32_t i = 0; i < settings.boxes; ++i)
+	{
+		physics2d::Box box;
+		box.position = { position(rng), position(rng) };
+		box.halfsize = { extent(rng), extent(rng) };
+		box.velocity = { speed(rng), speed(rng) };
+		world.boxes.push_back(box);
+	}
+	for (uint32_t i = 0; i < settings.spheres; ++i)
+	{
+		physics2d::Sphere sphere;
+		sphere.position = { position(rng), position(rng) };
+		sphere.radius = extent(rng);
+		sphere.velocity = { speed(rng), speed(rng) };
+		world.spheres.push_back(sphere);
+	}
+}
+
+// A corner of the incident face exactly on a side plane of the reference face, the other corner
+// past it. Box b sits 0.01 above the top face of a, within the margin, with its bottom left corner
+// on the plane x = 1 through the right side of a. Rotating b by a float 2 pi keeps its corners exact.
+bool checkCornerOnSidePlane() {
+	physics2d::Box a;
+	a.position = { 0.0f, 0.0f };
+	a.halfsize = { 1.0f, 1.0f };
+	physics2d::Box b;
+	b.position = { 1.5f, 1.26f };
+	b.halfsize = { 0.5f, 0.25f };
+	b.rotation = 6.2831855f;
+	physics2d::Contact contact;
+	if (!physics2d::collideBoxes(a, b, 0.02f, contact) || contact.pointCount != 1 || contact.points[0].position.x != 1.0f)
+	{
+		std::fprintf(stderr, "check failed: a corner on a side plane of the reference face makes no contact point\n");
+		return false;
+	}
+	return true;
+}
+
+// Compares one sphere against 8 boxes one at a time and in SIMD lanes
+void benchSphereBox(uint32_t spheres, uint32_t seed) {
+	using Clock = std::chrono::steady_clock;
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-4.0f, 4.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 1.0f);
+	std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+	physics2d::Box boxes[8];
+	for (auto& box : boxes)
+	{
+		box.position = { position(rng), position(rng) };
+		box.halfsize = { extent(rng), extent(rng) };
+		box.rotation = angle(rng);
+	}
+	std::vector<physics2d::Sphere> testSpheres(spheres);
+	for (auto& sphere : testSpheres)
+	{
+		sphere.position = { position(rng), position(rng) };
+		sphere.radius = extent(rng);
+	}
+
+	uint32_t scalarHits = 0;
+	auto start = Clock::now();
+	for (const auto& sphere : testSpheres)
+	{
+		for (const auto& box : boxes)
+		{
+			glm::vec2 normal;
+			float depth;
+			scalarHits += physics2d::sphereBoxContact(sphere, box, normal, depth);
+		}
+	}
+	double scalar = std::chrono::duration<double>(Clock::now() - start).count();
+
+	uint32_t batchHits = 0;
+	physics2d::BoxBatch batch = physics2d::makeBoxBatch(boxes, 8);
+	float normalX[8], normalY[8], depth[8];
+	start = Clock::now();
+	for (const auto& sphere : testSpheres)
+	{
+		uint32_t mask = physics2d::sphereBoxContacts(sphere, batch, normalX, normalY, depth);
+		for (; mask != 0; mask &= mask - 1)
+		{
+			++batchHits;
+		}
+	}
+	double batched = std::chrono::duration<double>(Clock::now() - start).count();
+
+	double tests = 8.0 * spheres;
+	std::printf("sphere vs box: scalar %.1f M tests/s, 8 wide batch %.1f M tests/s (%.2fx), hits %u/%u\n",
+		tests / scalar * 1e-6, tests / batched * 1e-6, scalar / batched, scalarHits, batchHits);
+}
+
+// Compares box pairs without rotation, which take the AABB path, with rotated ones that need the separating axis test
+void benchBoxBox(uint32_t pairs, uint32_t seed) {
+	using Clock = std::chrono::steady_clock;
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 1.0f);
+	std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+	std::vector<physics2d::Box> boxes(2 * pairs);
+	for (auto& box : boxes)
+	{
+		box.position = { position(rng), position(rng) };
+		box.halfsize = { extent(rng), extent(rng) };
+	}
+
+	auto run = [&](uint32_t& hits) {
+		hits = 0;
+		auto start = Clock::now();
+		for (uint32_t i = 0; i < pairs; ++i)
+		{
+			physics2d::Contact contact;
+			hits += physics2d::collideBoxes(boxes[2 * i], boxes[2 * i + 1], 0.02f, contact);
+		}
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	};
+	uint32_t alignedHits, orientedHits;
+	double aligned = run(alignedHits);
+	for (auto& box : boxes)
+	{
+		box.rotation = angle(rng);
+	}
+	double oriented = run(orientedHits);
+
+	std::printf("box vs box: aligned %.1f M tests/s, rotated %.1f M tests/s (%.2fx slower), hits %u/%u\n",
+		pairs / aligned * 1e-6, pairs / oriented * 1e-6, oriented / aligned, alignedHits, orientedHits);
+}
+
+int main(int argc, char** argv) {
+	BenchSettings settings;
+	if (!parseArgs(argc, argv, settings))
+	{
+		std::printf("Usage: %s [--spheres N] [--boxes N] [--steps N] [--dt S] [--broadphase tree|grid|sap] [--threads N] [--seed N] [--sleep 0|1] [--ccd 0|1]\n", argv[0]);
+		return 1;
+	}
+	if (!checkCornerOnSidePlane())
+	{
+		return 1;
+	}
+
+	physics2d::WorldSettings worldSettings;
+	worldSettings.broadphase = settings.broadphase;
+	worldSettings.threadCount = settings.threads;
+	worldSettings.allowSleeping = settings.sleeping;
+	worldSettings.continuousCollision = settings.continuousCollision;
+	physics2d::World world(worldSettings);
+	createScene(world, settings);
+
+	world.getJobSystem().resetStats();
+	physics2d::StepStats sum;
+	uint64_t pairTests = 0;
+	uint64_t contacts = 0;
+	uint64_t timeOfImpacts = 0;
+	for (uint32_t i = 0; i < settings.steps; ++i)
+	{
+		world.step(settings.dt);
+		const auto& stats = world.getStats();
+		sum.integrate += stats.integrate;
+		sum.broadphase += stats.broadphase;
+		sum.narrowphase += stats.narrowphase;
+		sum.response += stats.response;
+		pairTests += stats.pairTests;
+		contacts += stats.contacts;
+		timeOfImpacts += stats.timeOfImpacts;
+	}
+
+	const double total = sum.total();
+	const double steps = double(settings.steps);
+	std::printf("%u spheres, %u boxes, %u steps, dt %g\n", settings.spheres, settings.boxes, settings.steps, settings.dt);
+	std::printf("steps/sec:      %.1f\n", steps / total);
+	std::printf("pair tests/sec: %.0f (%.1f per step)\n", pairTests / total, pairTests / steps);
+	std::printf("contacts/step:  %.1f\n", contacts / steps);
+	std::printf("toi stops/step: %.1f\n", timeOfImpacts / steps);
+	std::printf("sleeping:       %u of %zu bodies after the last step\n", world.getStats().sleepingBodies, world.boxes.size() + world.spheres.size());
+	std::printf("per stage (ms/step): integrate %.3f, broadphase %.3f, narrowphase %.3f, response %.3f\n",
+		1e3 * sum.integrate / steps, 1e3 * sum.broadphase / steps, 1e3 * sum.narrowphase / steps, 1e3 * sum.response / steps);
+
+	const auto workers = world.getJobSystem().getWorkerStats();
+	std::printf("thread utilization:");
+	for (const auto& worker : workers)
+	{
+		std::printf(" %.0f%% (%llu jobs, %llu stolen)", 100.0 * worker.utilization, (unsigned long long)worker.jobs, (unsigned long long)worker.steals);
+	}
+	std::printf("\n");
+
+	benchSphereBox(1000000, settings.seed);
+	benchBoxBox(1000000, settings.seed);
+	return 0;
+}
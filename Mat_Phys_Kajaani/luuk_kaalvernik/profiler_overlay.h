@@ -0,0 +1,93 @@
+#pragma once
+#include <mikroplot/window.h>
+#include <glm/glm.hpp>
+#include <physics2d/profiler.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace physics2d {
+	///
+	/// \brief Palette color of the bars of zone in drawProfilerOverlay().
+	///
+	inline int getProfilerZoneColor(uint32_t zone) {
+		static const int colors[] = { 8, 9, 10, 13, 12, 11, 15, 16, 17, 20, 19, 18 };
+		return colors[zone % (sizeof(colors) / sizeof(colors[0]))];
+	}
+
+	///
+	/// \brief Draws the last frames of the profiler as stacked bars, newest on the right.
+	///
+	/// Every bar stacks the zone times of one frame, each zone in its own color.
+	/// A white line follows the wall time of the frames and a gray line marks 60 fps.
+	/// Drawn in the current screen coordinates of window, one drawLines() per zone.
+	///
+	/// \param position = Bottom left corner of the graph.
+	/// \param size = Width and height of the graph. The height stands for millisecondsHigh.
+	///
+	inline void drawProfilerOverlay(mikroplot::Window& window, const Profiler& profiler, glm::vec2 position, glm::vec2 size,
+		float millisecondsHigh = 33.3f, uint32_t frames = 120, size_t lineWidth = 3) {
+		const uint32_t count = std::min(frames, profiler.getFrameCount());
+		const uint32_t zones = profiler.getZoneCount();
+		if (count == 0)
+		{
+			return;
+		}
+
+		const float scale = size.y / (1e-3f * millisecondsHigh);
+		auto toY = [&](double seconds) {
+			return position.y + std::min(size.y, float(seconds) * scale);
+		};
+		auto toX = [&](uint32_t age) {
+			return position.x + size.x * (float(frames - age) - 0.5f) / float(frames);
+		};
+
+		// Where the bar of each frame is stacked up to so far
+		std::vector<double> top(count, 0.0);
+		std::vector<mikroplot::vec2> lines;
+		for (uint32_t zone = 0; zone < zones; ++zone)
+		{
+			lines.clear();
+			for (uint32_t age = 0; age < count; ++age)
+			{
+				const double seconds = profiler.getFrame(age).zoneSeconds[zone];
+				if (seconds <= 0.0)
+				{
+					continue;
+				}
+				const float x = toX(age);
+				lines.push_back({ x, toY(top[age]) });
+				top[age] += seconds;
+				lines.push_back({ x, toY(top[age]) });
+			}
+			if (!lines.empty())
+			{
+				window.drawLines(lines, getProfilerZoneColor(zone), lineWidth, false);
+			}
+		}
+
+		lines.clear();
+		for (uint32_t age = count; age-- > 0;)
+		{
+			lines.push_back({ toX(age), toY(profiler.getFrame(age).seconds) });
+		}
+		window.drawLines(lines, 2, 1);
+
+		const float budget = toY(1.0 / 60.0);
+		window.drawLines({ { position.x, budget }, { position.x + size.x, budget } }, 6, 1);
+	}
+
+	///
+	/// \brief Writes the kept frames to name.csv and name.json and prints which color is which zone.
+	///
+	inline void dumpProfiler(const Profiler& profiler, const std::string& name = "profile") {
+		const bool written = profiler.writeCsv(name + ".csv") && profiler.writeJson(name + ".json");
+		std::printf("%s %u frames to %s.csv and %s.json\n", written ? "Wrote" : "Failed to write",
+			profiler.getFrameCount(), name.c_str(), name.c_str());
+		for (uint32_t zone = 0; zone < profiler.getZoneCount(); ++zone)
+		{
+			std::printf("  color %2d: %s\n", getProfilerZoneColor(zone), profiler.getZoneName(zone).c_str());
+		}
+	}
+}
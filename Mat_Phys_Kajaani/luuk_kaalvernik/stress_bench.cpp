@@ -0,0 +1,334 @@
+#include <physics2d/world.h>
+#include <bench_args.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Steps generated scenes of growing size without any window and writes the results as JSON,
+// so runs of different builds can be compared by a script.
+// Usage: stress_bench [--scene NAME] [--max-bodies N] [--steps N] [--dt S]
+//                     [--broadphase tree|grid|sap] [--threads N] [--seed N] [--out FILE]
+// Without --scene every scene runs. --max-bodies skips the bigger ones, the largest has 1M spheres
+// and runs at most 20 steps.
+
+struct StressSettings {
+	std::string scene;
+	uint32_t maxBodies = 1000000;
+	uint32_t steps = 120;
+	float dt = 1.0f / 60.0f;
+	uint32_t threads = 0;
+	uint32_t seed = 1;
+	std::string out;
+	physics2d::BroadphaseType broadphase = physics2d::BroadphaseType::Tree;
+};
+
+struct Scene {
+	std::string name;
+	uint32_t bodies; // Dynamic bodies, without the static walls
+	std::function<void(physics2d::World&, std::mt19937&)> create;
+	uint32_t maxSteps = ~0u; // Keeps the biggest scenes from taking minutes
+};
+
+bool parseArgs(int argc, char** argv, StressSettings& settings) {
+	return physics2d::parseBenchArgs(argc, argv, [&](const std::string& name, const char* value) {
+		if (name == "--scene") settings.scene = value;
+		else if (name == "--max-bodies") settings.maxBodies = uint32_t(std::atoi(value));
+		else if (name == "--out") settings.out = value;
+		else return physics2d::parseWorldBenchOption(name, value, settings);
+		return true;
+	});
+}
+
+void addStaticBox(physics2d::World& world, glm::vec2 position, glm::vec2 halfsize) {
+	physics2d::Box box;
+	box.position = position;
+	box.halfsize = halfsize;
+	box.isStatic = true;
+	world.boxes.push_back(box);
+}
+
+// Four walls around [-size, size], so nothing leaves the scene
+void addArena(physics2d::World& world, float size) {
+	addStaticBox(world, { 0, -size }, { size, 0.5f });
+	addStaticBox(world, { -size, 0 }, { 0.5f, size });
+	addStaticBox(world, { size, 0 }, { 0.5f, size });
+	addStaticBox(world, { 0, size }, { size, 0.5f });
+}
+
+// Spheres moving in every direction inside a closed arena. The arena grows with
+// the count so the density, and with it the contacts per body, stays the same.
+Scene spheresInBox(uint32_t count) {
+	return { "spheres_in_box_" + std::to_string(count), count, [count](physics2d::World& world, std::mt19937& rng) {
+		const float size = std::max(10.0f, 0.5f * std::sqrt(float(count)));
+		addArena(world, size);
+		std::uniform_real_distribution<float> position(-size + 1.0f, size - 1.0f);
+		std::uniform_real_distribution<float> radius(0.1f, 0.2f);
+		std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+		world.spheres.reserve(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			physics2d::Sphere sphere;
+			sphere.position = { position(rng), position(rng) };
+			sphere.radius = radius(rng);
+			sphere.velocity = { speed(rng), speed(rng) };
+			world.spheres.push_back(sphere);
+		}
+	} };
+}
+
+// Columns of resting boxes on a floor. Tests how the solver copes with long chains of contacts.
+Scene boxStacks(uint32_t columns, uint32_t height) {
+	return { "box_stacks_" + std::to_string(columns) + "x" + std::to_string(height), columns * height,
+		[columns, height](physics2d::World& world, std::mt19937&) {
+		const float spacing = 1.5f;
+		const float width = 0.5f * spacing * float(columns) + 1.0f;
+		addStaticBox(world, { 0, -0.5f }, { width, 0.5f });
+		for (uint32_t column = 0; column < columns; ++column)
+		{
+			const float x = -0.5f * spacing * float(columns - 1) + spacing * float(column);
+			for (uint32_t row = 0; row < height; ++row)
+			{
+				physics2d::Box box;
+				box.position = { x, 0.5f + float(row) };
+				box.halfsize = { 0.5f, 0.5f };
+				box.restitution = 0.0f;
+				world.boxes.push_back(box);
+			}
+		}
+	} };
+}
+
+// Boxes and spheres from pebbles to boulders. Uniform grids do badly when sizes differ this much.
+Scene mixedSizes(uint32_t count) {
+	return { "mixed_sizes_" + std::to_string(count), count, [count](physics2d::World& world, std::mt19937& rng) {
+		const float size = std::max(20.0f, std::sqrt(float(count)));
+		addArena(world, size);
+		std::uniform_real_distribution<float> position(-size + 3.0f, size - 3.0f);
+		std::uniform_real_distribution<float> logExtent(std::log(0.05f), std::log(2.0f));
+		std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const glm::vec2 center(position(rng), position(rng));
+			if (i % 2 == 0)
+			{
+				physics2d::Box box;
+				box.position = center;
+				box.halfsize = { std::exp(logExtent(rng)), std::exp(logExtent(rng)) };
+				box.velocity = { speed(rng), speed(rng) };
+				world.boxes.push_back(box);
+			}
+			else
+			{
+				physics2d::Sphere sphere;
+				sphere.position = center;
+				sphere.radius = std::exp(logExtent(rng));
+				sphere.velocity = { speed(rng), speed(rng) };
+				world.spheres.push_back(sphere);
+			}
+		}
+	} };
+}
+
+// Spheres dropped from different heights onto staggered static floors. They arrive
+// fast and a few at a time, so continuous collision and waking sleeping piles get busy.
+Scene sphereRain(uint32_t count) {
+	return { "sphere_rain_" + std::to_string(count), count, [count](physics2d::World& world, std::mt19937& rng) {
+		// Open at the top, the spheres start above the walls and fall straight down into the arena
+		const float size = std::max(10.0f, 0.5f * std::sqrt(float(count)));
+		addStaticBox(world, { 0, -size }, { size, 0.5f });
+		addStaticBox(world, { -size, 0 }, { 0.5f, size });
+		addStaticBox(world, { size, 0 }, { 0.5f, size });
+		for (uint32_t floor = 0; floor < 4; ++floor)
+		{
+			const float x = (floor % 2 == 0 ? -0.4f : 0.4f) * size;
+			addStaticBox(world, { x, -size + 0.3f * size * float(floor + 1) }, { 0.35f * size, 0.1f });
+		}
+		std::uniform_real_distribution<float> x(-size + 1.0f, size - 1.0f);
+		std::uniform_real_distribution<float> height(0.0f, 10.0f * size);
+		std::uniform_real_distribution<float> radius(0.1f, 0.2f);
+		world.spheres.reserve(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			physics2d::Sphere sphere;
+			sphere.position = { x(rng), size - 1.0f + height(rng) };
+			sphere.radius = radius(rng);
+			sphere.restitution = 0.2f;
+			world.spheres.push_back(sphere);
+		}
+	} };
+}
+
+struct StageTimes {
+	std::vector<double> integrate;
+	std::vector<double> broadphase;
+	std::vector<double> narrowphase;
+	std::vector<double> response;
+	std::vector<double> total;
+};
+
+// Nearest rank percentile of times, in milliseconds
+double percentile(std::vector<double> times, double p) {
+	if (times.empty())
+	{
+		return 0.0;
+	}
+	std::sort(times.begin(), times.end());
+	const size_t rank = size_t(std::ceil(p / 100.0 * double(times.size())));
+	return 1e3 * times[std::min(times.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+void writeStage(FILE* out, const char* name, const std::vector<double>& times, bool last) {
+	std::fprintf(out, "        \"%s\": { \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+		name, percentile(times, 50), percentile(times, 90), percentile(times, 99), percentile(times, 100), last ? "" : ",");
+}
+
+void runScene(FILE* out, const Scene& scene, const StressSettings& settings, bool last) {
+	using Clock = std::chrono::steady_clock;
+	physics2d::WorldSettings worldSettings;
+	worldSettings.broadphase = settings.broadphase;
+	worldSettings.threadCount = settings.threads;
+	physics2d::World world(worldSettings);
+	const uint32_t stepCount = std::min(settings.steps, scene.maxSteps);
+	std::mt19937 rng(settings.seed);
+	auto start = Clock::now();
+	scene.create(world, rng);
+	const double setup = std::chrono::duration<double>(Clock::now() - start).count();
+
+	StageTimes times;
+	uint64_t pairTests = 0;
+	uint64_t contacts = 0;
+	uint64_t timeOfImpacts = 0;
+	size_t peakMemory = 0;
+	world.getJobSystem().resetStats();
+	start = Clock::now();
+	for (uint32_t i = 0; i < stepCount; ++i)
+	{
+		world.step(settings.dt);
+		const auto& stats = world.getStats();
+		times.integrate.push_back(stats.integrate);
+		times.broadphase.push_back(stats.broadphase);
+		times.narrowphase.push_back(stats.narrowphase);
+		times.response.push_back(stats.response);
+		times.total.push_back(stats.total());
+		pairTests += stats.pairTests;
+		contacts += stats.contacts;
+		timeOfImpacts += stats.timeOfImpacts;
+		peakMemory = std::max(peakMemory, world.getMemoryUsage());
+	}
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	const double steps = double(std::max(1u, stepCount));
+	// The static walls are left out of the body count, as in Scene::bodies
+	const uint32_t bodies = scene.bodies;
+	const size_t staticBodies = world.boxes.size() + world.spheres.size() - bodies;
+
+	double utilization = 0.0;
+	const auto workers = world.getJobSystem().getWorkerStats();
+	for (const auto& worker : workers)
+	{
+		utilization += worker.utilization / double(workers.size());
+	}
+
+	std::fprintf(out, "    {\n");
+	std::fprintf(out, "      \"name\": \"%s\",\n", scene.name.c_str());
+	std::fprintf(out, "      \"bodies\": %u,\n", bodies);
+	std::fprintf(out, "      \"static_bodies\": %zu,\n", staticBodies);
+	std::fprintf(out, "      \"steps\": %u,\n", stepCount);
+	std::fprintf(out, "      \"setup_seconds\": %.4f,\n", setup);
+	std::fprintf(out, "      \"steps_per_second\": %.3f,\n", stepCount / elapsed);
+	std::fprintf(out, "      \"pair_tests_per_step\": %.1f,\n", pairTests / steps);
+	std::fprintf(out, "      \"contacts_per_step\": %.1f,\n", contacts / steps);
+	std::fprintf(out, "      \"time_of_impacts_per_step\": %.1f,\n", timeOfImpacts / steps);
+	std::fprintf(out, "      \"sleeping_bodies\": %u,\n", world.getStats().sleepingBodies);
+	std::fprintf(out, "      \"peak_memory_bytes\": %zu,\n", peakMemory);
+	std::fprintf(out, "      \"memory_bytes_per_body\": %.1f,\n", double(peakMemory) / double(std::max(1u, bodies)));
+	std::fprintf(out, "      \"thread_utilization\": %.3f,\n", utilization);
+	std::fprintf(out, "      \"stage_ms\": {\n");
+	writeStage(out, "integrate", times.integrate, false);
+	writeStage(out, "broadphase", times.broadphase, false);
+	writeStage(out, "narrowphase", times.narrowphase, false);
+	writeStage(out, "response", times.response, false);
+	writeStage(out, "total", times.total, true);
+	std::fprintf(out, "      }\n");
+	std::fprintf(out, "    }%s\n", last ? "" : ",");
+	std::fflush(out);
+
+	// Progress goes to stderr, so stdout stays valid JSON
+	std::fprintf(stderr, "%-28s %8u bodies %10.1f steps/s\n", scene.name.c_str(), bodies, stepCount / elapsed);
+}
+
+int main(int argc, char** argv) {
+	StressSettings settings;
+	if (!parseArgs(argc, argv, settings))
+	{
+		std::printf("Usage: %s [--scene NAME] [--max-bodies N] [--steps N] [--dt S] [--broadphase tree|grid|sap] [--threads N] [--seed N] [--out FILE]\n", argv[0]);
+		return 1;
+	}
+
+	const std::vector<Scene> allScenes = {
+		spheresInBox(1000),
+		spheresInBox(10000),
+		spheresInBox(100000),
+		[] { Scene scene = spheresInBox(1000000); scene.maxSteps = 20; return scene; }(),
+		boxStacks(10, 10),
+		boxStacks(100, 20),
+		mixedSizes(1000),
+		mixedSizes(10000),
+		sphereRain(10000),
+		sphereRain(100000),
+	};
+	std::vector<const Scene*> scenes;
+	for (const auto& scene : allScenes)
+	{
+		if (scene.bodies <= settings.maxBodies && (settings.scene.empty() || scene.name == settings.scene))
+		{
+			scenes.push_back(&scene);
+		}
+	}
+	if (scenes.empty())
+	{
+		std::fprintf(stderr, "No scene matches, the scenes are:\n");
+		for (const auto& scene : allScenes)
+		{
+			std::fprintf(stderr, "  %s (%u bodies)\n", scene.name.c_str(), scene.bodies);
+		}
+		return 1;
+	}
+
+	FILE* out = settings.out.empty() ? stdout : std::fopen(settings.out.c_str(), "w");
+	if (out == nullptr)
+	{
+		std::fprintf(stderr, "Can not open %s\n", settings.out.c_str());
+		return 1;
+	}
+
+#if defined(__AVX__)
+	const char* simd = "avx";
+#elif defined(__SSE2__) || defined(_M_X64)
+	const char* simd = "sse";
+#else
+	const char* simd = "scalar";
+#endif
+	const uint32_t threads = settings.threads != 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+	std::fprintf(out, "{\n");
+	std::fprintf(out, "  \"build\": { \"simd\": \"%s\", \"threads\": %u, \"broadphase\": \"%s\", \"dt\": %g, \"seed\": %u },\n",
+		simd, threads, physics2d::getBroadphaseName(settings.broadphase), settings.dt, settings.seed);
+	std::fprintf(out, "  \"scenes\": [\n");
+	for (size_t i = 0; i < scenes.size(); ++i)
+	{
+		runScene(out, *scenes[i], settings, i + 1 == scenes.size());
+	}
+	std::fprintf(out, "  ]\n");
+	std::fprintf(out, "}\n");
+	if (out != stdout)
+	{
+		std::fclose(out);
+	}
+	return 0;
+}
@@ -2,6 +2,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/random.hpp> // Include this header for glm::linearRand
 #include <glm/gtx/rotate_vector.hpp> // Include this header for glm::rotate
+#include <physics2d/fixed_timestep.h>
+#include <physics2d/job_system.h>
+#include <profiler_overlay.h>
 
 ///
 /// \brief The Point class
@@ -9,6 +12,7 @@
 struct Point {
 	glm::vec2 position;
 	glm::vec2 velocity = glm::vec2(0,0);
+	glm::vec2 oldPosition; // Position before the last step, for drawing in between
 	float lifeSpan = 0;
 	float aliveTime = 0;
 
@@ -36,6 +40,7 @@ struct ParticleEmitter {
 		if (internalTimer > (1.0f / particlesPerSecond)) {
 			Point point;
 			point.position = position;
+			point.oldPosition = position;
 
 			// Calculate random angle within the specified cone angle
 			float randomAngle = glm::linearRand(-coneAngle / 2.0f, coneAngle / 2.0f);
@@ -160,35 +165,84 @@ int main() {
 	body.velocity *= 0.5f;
 	float startDelay = 2.0f;*/
 
+	// Physics runs at a fixed 240 Hz no matter how fast the window renders
+	physics2d::FixedTimestep fixedStep(240.0f);
+	physics2d::JobSystem jobs;
+	std::vector<mikroplot::vec2> particlePosition;
+
+	// O starts the profiler and shows the frame time of each zone as stacked bars,
+	// P writes the last frames to profile.csv and profile.json
+	physics2d::Profiler& profiler = physics2d::Profiler::get();
+	bool showProfiler = false;
+
 	while (!window.shouldClose()) {
-		float dt = timer.getDeltaTime();
-		
-		/*startDelay -= dt;
-		if (startDelay < 0.0f)
+		if (window.getKeyPressed(KEY_O))
 		{
-			body = simulate(body, dt);
-		}*/
+			showProfiler = !showProfiler;
+			profiler.setEnabled(showProfiler);
+		}
+		if (window.getKeyPressed(KEY_P))
+		{
+			physics2d::dumpProfiler(profiler);
+		}
 
-		emitter.emitParticle(dt, points);
-		std::vector<mikroplot::vec2> particlePosition;
+		fixedStep.advance(timer.getDeltaTime(), [&](float dt) {
+			PHYSICS2D_PROFILE_ZONE("simulate");
+			/*startDelay -= dt;
+			if (startDelay < 0.0f)
+			{
+				body = simulate(body, dt);
+			}*/
+
+			// Emitting adds particles, so the update waits for it. Particles do not
+			// touch each other, so the update is spread over all cores.
+			auto emit = jobs.submit([&] { emitter.emitParticle(dt, points); });
+			auto update = jobs.submit([&] {
+				jobs.wait(jobs.parallelFor(uint32_t(points.size()), [&](uint32_t begin, uint32_t end) {
+					for (uint32_t i = begin; i < end; ++i)
+					{
+						Point& body = points[i];
+						if (body.isAlive(dt))
+						{
+							body.oldPosition = body.position;
+							body = simulate(body, dt, windForce, emitter);
+						}
+					}
+				}, {}, 256));
+			}, { emit });
+			jobs.wait(update);
+		});
 
-		// Update simulation
-		for  (Point& body : points)
 		{
-			if (body.isAlive(dt))
+			PHYSICS2D_PROFILE_ZONE("draw");
+			// Construct point(s) to draw from body position(s), between the last two physics states
+			const float alpha = fixedStep.getAlpha();
+			particlePosition.clear();
+			for (const Point& body : points)
 			{
-				body = simulate(body, dt, windForce, emitter);
-				// Construct point(s) to draw from body position(s)
-				particlePosition.push_back({ body.position.x, body.position.y });
+				if (body.lifeSpan >= body.aliveTime)
+				{
+					glm::vec2 position = physics2d::interpolate(body.oldPosition, body.position, alpha);
+					particlePosition.push_back({ position.x, position.y });
+				}
 			}
-		}
 
-		// Render
-		window.setScreen(-1, 11, -1, 11);
-		window.drawAxis();
+			// Render
+			window.setScreen(-1, 11, -1, 11);
+			window.drawAxis();
 		
-		window.drawPoints(particlePosition, 11, 10);
-		window.update();
+			window.drawPoints(particlePosition, 11, 10);
+		}
+		if (showProfiler)
+		{
+			drawProfilerOverlay(window, profiler, { -0.8f, 8.0f }, { 5.0f, 2.5f });
+		}
+
+		{
+			PHYSICS2D_PROFILE_ZONE("Window::update");
+			window.update();
+		}
+		profiler.endFrame();
 	}
 
 	return 0;
@@ -1,41 +1,66 @@
 #include <mikroplot/window.h>
 #include <glm/glm.hpp>
+#include <math_utils.h>
+#include <cmath>
+#include <cstdio>
 
+// Constants are per second, 60 times what they would be if added once per frame at 60 fps
 struct Spring {
-	float k = 0.1f;  // Spring constant
-	float damping = 0.01f;  // Damping factor
+	float k = 6.0f;  // Spring constant
+	float damping = 0.6f;  // Damping factor, share of velocity lost per second
 	float restLength = 2; // spring length in rest
 	glm::vec2 springRoot = glm::vec2(5,10);
 	glm::vec2 springEnd = glm::vec2(7, 4);
 	//glm::vec2 springEnd = glm::vec2(5, 0);
 	glm::vec2 velocity = glm::vec2(0, 0);
+	glm::vec2 acceleration = glm::vec2(0, 0); // At springEnd, carried from one step to the next
 };
 
-template<typename Body, typename S>
-Body simulate(Body body, S dt) {
+template<typename Body>
+glm::vec2 springAcceleration(const Body& body, const glm::vec2& springEnd) {
 	//float mass = 1.0f; 
 	// 
 	// Mass is consistantly 1 in this world.
 	// This makes it so the force of the spring = acceleration.
 	// F = m*a | F = 1*a = a
 
-	glm::vec2 gravity = glm::vec2(0, -0.01f);
+	glm::vec2 gravity = glm::vec2(0, -0.6f);
 
 	// Spring force F = a
-	glm::vec2 force = body.springRoot - body.springEnd;
+	glm::vec2 force = body.springRoot - springEnd;
 	auto x = glm::length(force) - body.restLength;
 	glm::vec2 springForce = glm::normalize(force);
 	springForce *= body.k * x;
 
+	return springForce + gravity;
+}
+
+template<typename Body, typename S>
+Body simulate(Body body, S dt) {
+	// Velocity Verlet keeps the energy of the spring from growing step by step,
+	// so long frames do not make it swing further and further
+	integrate::velocityVerlet(body.springEnd, body.velocity, body.acceleration, dt,
+		[&](const glm::vec2& springEnd, S) { return springAcceleration(body, springEnd); });
+
 	// Damping
-	glm::vec2 totalForce = springForce + gravity;
-	body.velocity += totalForce;
+	body.velocity *= std::exp(-body.damping * dt);
 
-	// Eulers integration
-	glm::vec2 totalVelocity = body.velocity * dt;
-	body.springEnd += totalVelocity;
+	return body;
+}
 
-	body.velocity *= (1.0f - body.damping);
+template<typename Body, typename S>
+Body simulateImplicit(Body body, S dt) {
+	// Backward Euler solves for the state at the end of the step, so even a very stiff
+	// spring stays stable at the frame rate, its fast swings are damped away instead
+	glm::vec4 state(body.springEnd, body.velocity);
+	state = integrate::backwardEuler(state, dt, [&](const glm::vec4& x, S) {
+		return glm::vec4(x.z, x.w, springAcceleration(body, glm::vec2(x.x, x.y)));
+	});
+	body.springEnd = glm::vec2(state.x, state.y);
+	body.velocity = glm::vec2(state.z, state.w) * std::exp(-body.damping * dt);
+
+	// Ready for velocity Verlet if the integrator is switched back
+	body.acceleration = springAcceleration(body, body.springEnd);
 
 	return body;
 }
@@ -48,12 +73,29 @@ int main() {
 
 	// Use default spring
 	Spring spring;
+	spring.acceleration = springAcceleration(spring, spring.springEnd);
+
+	// K makes the spring 10000 times stiffer, which velocity Verlet cannot follow at the frame rate.
+	// I switches to the implicit integrator that can.
+	bool implicit = false;
 
 	while (!window.shouldClose()) {
 		float dt = timer.getDeltaTime();
 
+		if (window.getKeyPressed(KEY_K))
+		{
+			spring.k = spring.k == 6.0f ? 60000.0f : 6.0f;
+			spring.acceleration = springAcceleration(spring, spring.springEnd);
+			std::printf("Spring constant %g\n", spring.k);
+		}
+		if (window.getKeyPressed(KEY_I))
+		{
+			implicit = !implicit;
+			std::printf("%s\n", implicit ? "Backward Euler" : "Velocity Verlet");
+		}
+
 		// Update simulation
-		spring = simulate(spring, dt);
+		spring = implicit ? simulateImplicit(spring, dt) : simulate(spring, dt);
 
 		// Render
 		window.setScreen(-5, 10, -5, 15);
@@ -1,6 +1,16 @@
 #include <mikroplot/window.h>
 #include <glm/glm.hpp>
-#include <glm/gtx/transform.hpp>
+#include <array>
+#include <physics2d/collision.h>
+#include <physics2d/contact_cache.h>
+#include <physics2d/contact_solver.h>
+#include <physics2d/sweep_and_prune.h>
+#include <physics2d/fixed_timestep.h>
+#include <physics2d/time_of_impact.h>
+
+// Collision layers, a pair is only tested when each box is in the mask of the other
+const uint32_t PlayerCategory = 1 << 0;
+const uint32_t LevelCategory = 1 << 1;
 
 struct Box
 {
@@ -11,129 +21,90 @@ struct Box
 	bool isPlayer = false;
 	bool isJumpReset = false;
 	bool isBouncy = false;
+	uint32_t category = LevelCategory;
+	uint32_t mask = PlayerCategory; // The level only needs to stop the player
 	glm::vec2 velocity = glm::vec2(0);
-	glm::vec2 oldPosition;
+	glm::vec2 oldPosition = glm::vec2(0);
 };
 
 // Create the map, maybe replace this with a level loader in the future?
 void createMap(std::vector<Box>& boxes) {
-	Box floor = { {0, -9.0f}, {9.0f, 0.5f} };
+	Box floor = { .position = {0, -9.0f}, .halfsize = {9.0f, 0.5f} };
 	floor.isStatic = true;
 	floor.isJumpReset = true;
 	boxes.push_back(floor);
 
-	Box middlePlatform = { {0, -3.0f}, {4.5f, 0.5f} };
+	Box middlePlatform = { .position = {0, -3.0f}, .halfsize = {4.5f, 0.5f} };
 	middlePlatform.isStatic = true;
 	middlePlatform.isJumpReset = true;
 	boxes.push_back(middlePlatform);
 
-	Box leftWall = { {-9.0, -4.0f}, {0.5f, 2.0f} };
+	Box leftWall = { .position = {-9.0, -4.0f}, .halfsize = {0.5f, 2.0f} };
 	leftWall.isStatic = true; 
 	leftWall.isJumpReset = true;
 	boxes.push_back(leftWall);
 	
-	Box rightWall = { {9.0, -4.0f}, {0.5f, 2.0f} };
+	Box rightWall = { .position = {9.0, -4.0f}, .halfsize = {0.5f, 2.0f} };
 	rightWall.isStatic = true;
 	rightWall.isBouncy = true;
 	rightWall.isJumpReset = true;
 	boxes.push_back(rightWall);
 
-	Box topLeftWall = { {-3.0, 0}, {1.0f, 2.0f} };
+	Box topLeftWall = { .position = {-3.0, 0}, .halfsize = {1.0f, 2.0f} };
 	topLeftWall.isStatic = true;
 	topLeftWall.isJumpReset = true;
 	boxes.push_back(topLeftWall);
 	
-	Box topRightWall = { {3.0, 0}, {1.0f, 2.0f} };
+	Box topRightWall = { .position = {3.0, 0}, .halfsize = {1.0f, 2.0f} };
 	topRightWall.isStatic = true;
 	boxes.push_back(topRightWall);
 }
 
-// We only have AABB collisions in the game by design.
-bool isAABBCollision(const Box& a, const Box& b, glm::vec2& normalVec) {
-	glm::vec2 d = b.position - a.position;
-	glm::vec2 hs = b.halfsize + a.halfsize;
-	bool x = std::abs(d.x) < hs.x;
-	bool y = std::abs(d.y) < hs.y;
-
-	if (x && y)
-	{
-		float overlapX = hs.x - std::abs(d.x);
-		float overlapY = hs.y - std::abs(d.y);
-		// normalVec = glm::normalize(-d);
-		if (overlapX > overlapY)
-		{
-			normalVec.y = overlapY;
-			normalVec.x = 0;
-			normalVec = glm::normalize(normalVec);
-		} else
-		{
-			normalVec.y = 0;
-			normalVec.x = overlapX;
-			normalVec = glm::normalize(normalVec);
-		}
-		return true;
-	}
-
-	return false;
+// Boxes never rotate in the game, so the model transform is just scale and translate
+std::array<glm::vec2, 5> getVertices(const Box& box, float scale) {
+	glm::vec2 hs = scale * box.halfsize;
+	return {
+		box.position + glm::vec2(-hs.x, hs.y), // Top left
+		box.position + glm::vec2(-hs.x, -hs.y), // Bottem left
+		box.position + glm::vec2(hs.x, -hs.y), // Bottem right
+		box.position + glm::vec2(hs.x, hs.y), // Top right
+		// Top left (again because we want to close "line loop")
+		box.position + glm::vec2(-hs.x, hs.y),
+	};
 }
 
+physics2d::AABB getAABB(const Box& box) {
+	return physics2d::makeAABB(box.position, box.halfsize);
+}
 
-std::vector<glm::vec2> getVertices(const Box& box, float scale) {
-	std::vector<glm::vec2> vertices;
-
-	vertices.push_back(glm::vec2(-box.halfsize.x, box.halfsize.y)); // Top left
-	vertices.push_back(glm::vec2(-box.halfsize.x, -box.halfsize.y)); // Bottem left
-	vertices.push_back(glm::vec2(box.halfsize.x, -box.halfsize.y)); // Bottem right
-	vertices.push_back(glm::vec2(box.halfsize.x, box.halfsize.y)); // Top right
-	// Top left (again because we want to close "line loop")
-	vertices.push_back(glm::vec2(-box.halfsize.x, box.halfsize.y));
-
-	// Transform vertices using matrices
-	glm::mat4 matTranslation = glm::translate(glm::vec3(box.position /*x,y*/, 0.0f /*z == 0*/));
-	glm::mat4 matScale = glm::scale(glm::vec3(scale, scale, scale));
+const glm::vec2 gravity(0, -9.81f);
 
-	glm::mat4 mathModel = matTranslation * matScale;
-	// matModel is the model matrix for our object.
-	for (auto& vert : vertices)
+// Only gravity here, the positions are moved after the contacts are solved
+void integrateVelocities(std::vector<Box>& boxes, float deltaTime) {
+	for (auto& box : boxes)
 	{
-		// M *<vert.x, vert.y, 0, 1>
-		vert = mathModel * glm::vec4(vert, 0, 1);
-	}
-
-	return vertices;
-}
-
-void simulate(auto& objects, float deltaTime) {
-	for (auto& obj : objects){
-		obj.oldPosition = obj.position;
-		if (obj.isStatic)
+		box.oldPosition = box.position;
+		if (!box.isStatic)
 		{
-			continue;
+			box.velocity += gravity * deltaTime;
 		}
-		auto oldPosition = obj.position;
-		glm::vec2 gravity(0, -9.81f);
-		
-		obj.velocity += gravity * deltaTime;
-		obj.position += obj.velocity * deltaTime;
 	}
 }
 
-// TODO:
-// Implement better collisions and different collisions based on the a/b
-void reactCollision(auto& a, auto& b, const glm::vec2& normalVec) {
-	// A normal surface will remove a lot of energy
-	float dissapation = 0.1f;
-
-	// If a surface is bouncy it will not remove a lot of energy/velocity on impact
-	if (a.isBouncy || b.isBouncy)
-	{
-		dissapation = 1.5f;
-	}
-
-	a.velocity = dissapation * glm::reflect(a.velocity, normalVec);
-	b.velocity = dissapation * glm::reflect(b.velocity, -normalVec);
+// We only have AABB collisions in the game by design, so a box without rotation is all the collision code needs
+physics2d::Box toPhysicsBox(const Box& box) {
+	return { .position = box.position, .halfsize = box.halfsize };
 }
 
+physics2d::SolverBody toSolverBody(const Box& box) {
+	physics2d::SolverBody body;
+	body.velocity = box.velocity;
+	body.displacement = glm::vec2(0);
+	body.inverseMass = box.isStatic ? 0.0f : 1.0f / (4.0f * box.halfsize.x * box.halfsize.y);
+	// A normal surface will remove a lot of energy, a bouncy one even adds some on impact
+	body.restitution = box.isBouncy ? 1.5f : 0.1f;
+	return body;
+}
 
 int main() {
 	mikroplot::Window window(900, 900, "AABB Points");
@@ -147,72 +118,172 @@ int main() {
 	player.halfsize.x = 0.5f;
 	player.halfsize.y = 0.5f;
 	player.isPlayer = true;
+	player.category = PlayerCategory;
+	player.mask = LevelCategory;
 
 	int totalJumps = 2;
 	int currentJumps = 2;
+	const float jumpSpeed = 7.5f;
+	// Set when space is pressed, a frame may run no physics step so it waits for the next one
+	bool jumpPending = false;
 
 	boxes.push_back(player);
 
 	createMap(boxes);
 
+	// Most of the level is static, so the sorted axes barely change between frames
+	physics2d::SweepAndPrune broadphase;
+	std::vector<physics2d::AABB> bounds;
+	std::vector<bool> isStatic;
+	std::vector<physics2d::CollisionFilter> filters;
+	std::vector<physics2d::ProxyPair> pairs;
+
+	// Contacts are solved with impulses, warm started from the contacts of the last step
+	const float contactMargin = 0.02f;
+	physics2d::JobSystem jobs(1);
+	physics2d::ContactSolver solver(jobs);
+	physics2d::SolverSettings solverSettings;
+	solverSettings.gravity = gravity;
+	physics2d::ContactCache contactCache;
+	std::vector<physics2d::Contact> contacts;
+	std::vector<physics2d::SolverBody> solverBodies;
+	std::vector<float> timeOfImpact;
+
+	// Reused for drawing every box, so it does not allocate each frame
+	std::vector<mikroplot::vec2> points;
+
+	// Nothing to interpolate from before the first step
+	for (auto& box : boxes)
+	{
+		box.oldPosition = box.position;
+	}
+
+	// Physics runs at a fixed 60 Hz no matter how fast the window renders.
+	// Continuous collision keeps fast boxes out of the thin walls, so no smaller steps are needed.
+	physics2d::FixedTimestep fixedStep(60.0f);
 	mikroplot::Timer timer;
 	float totalTime = 0;
 	while (window.shouldClose() == false)
 	{
-		float deltaTime = timer.getDeltaTime();
-		if (deltaTime > 0.1f)
-		{
-			deltaTime = 0.1f;
-		}
-		totalTime += deltaTime;
-
 		// Move the player:
 		float moveX = window.getKeyState(mikroplot::KEY_RIGHT) - window.getKeyState(mikroplot::KEY_LEFT);
-		float jump = 0;
 
 		// Implement jumping
 		if (window.getKeyPressed(mikroplot::KEY_SPACE) && currentJumps > 0)
 		{
-			jump = 7.5f;
-			currentJumps--;
+			jumpPending = true;
 		}
-		
-		// Position [0] is always the player
-		// Update velocity instead of position to smooth out jump and to make sure hitboxes are working
-		boxes[0].velocity += glm::vec2(moveX * deltaTime * 5, jump);
 
-		simulate(boxes, deltaTime);
+		fixedStep.advance(timer.getDeltaTime(), [&](float deltaTime) {
+			totalTime += deltaTime;
 
-		// Reset collision flags from previous frame
-		for (size_t i = 0; i < boxes.size(); ++i)
-		{
-			boxes[i].isColliding = false;
-		}
+			// Position [0] is always the player
+			// Update velocity instead of position to smooth out jump and to make sure hitboxes are working
+			boxes[0].velocity.x += moveX * deltaTime * 5;
+			// The jump is a single kick, so only the first step after the key press gets it
+			if (jumpPending && currentJumps > 0)
+			{
+				boxes[0].velocity.y += jumpSpeed;
+				currentJumps--;
+			}
+			jumpPending = false;
 
-		// Check collisions between each object:
-		for (size_t ia = 0; ia < boxes.size(); ++ia)
-		{
-			for (size_t ib = ia + 1; ib < boxes.size(); ++ib)
+			integrateVelocities(boxes, deltaTime);
+
+			// Reset collision flags from previous frame
+			for (size_t i = 0; i < boxes.size(); ++i)
+			{
+				boxes[i].isColliding = false;
+			}
+
+			// Broadphase: proxy ids are indices into boxes, grown so boxes within the margin are paired.
+			// Fast boxes cover their whole path, so they cannot skip over a wall between two steps.
+			const glm::vec2 grow(0.5f * contactMargin);
+			bounds.clear();
+			isStatic.clear();
+			filters.clear();
+			for (const auto& box : boxes)
 			{
-				glm::vec2 normal;
-				if (isAABBCollision(boxes[ia], boxes[ib], normal))
+				physics2d::AABB aabb = getAABB(box);
+				glm::vec2 displacement = box.velocity * deltaTime;
+				if (glm::dot(displacement, displacement) > contactMargin * contactMargin)
 				{
-					boxes[ia].isColliding = true;
-					boxes[ib].isColliding = true;
-					boxes[ia].position = boxes[ia].oldPosition;
-					boxes[ib].position = boxes[ib].oldPosition;
-					reactCollision(boxes[ia], boxes[ib], normal);
-
-					if (boxes[ia].isPlayer && boxes[ib].isJumpReset)
-					{
-						currentJumps = totalJumps;
-					}
-					else if (boxes[ib].isPlayer && boxes[ia].isJumpReset) {
-						currentJumps = totalJumps;
-					}
+					aabb = physics2d::combine(aabb, { aabb.min + displacement, aabb.max + displacement });
 				}
+				bounds.push_back({ aabb.min - grow, aabb.max + grow });
+				isStatic.push_back(box.isStatic);
+				filters.push_back({ box.category, box.mask });
 			}
-		}
+			broadphase.update(bounds, isStatic, filters);
+			pairs.clear();
+			broadphase.findPairs(pairs);
+
+			// Find contacts between candidate pairs only:
+			contacts.clear();
+			for (const auto& pair : pairs)
+			{
+				physics2d::Contact contact;
+				contact.a = pair.a;
+				contact.b = pair.b;
+				if (physics2d::collideBoxes(toPhysicsBox(boxes[pair.a]), toPhysicsBox(boxes[pair.b]), contactMargin, contact))
+				{
+					contacts.push_back(contact);
+				}
+			}
+			contactCache.warmStart(contacts);
+
+			// Solve velocities, then move and push out of whatever penetration is left
+			solverBodies.clear();
+			for (const auto& box : boxes)
+			{
+				solverBodies.push_back(toSolverBody(box));
+			}
+			solver.solveVelocities(contacts, solverBodies, solverSettings, deltaTime);
+			contactCache.store(contacts);
+			for (auto& body : solverBodies)
+			{
+				body.displacement = body.velocity * deltaTime;
+			}
+			solver.solvePositions(solverBodies, solverSettings);
+
+			// Pairs without a contact were further apart than the margin, stop boxes where they would first touch
+			auto sweep = [&](const physics2d::ProxyPair& pair, const glm::vec2& displacement, float& toi) {
+				return physics2d::sweepAABB(getAABB(boxes[pair.a]), displacement, getAABB(boxes[pair.b]), toi);
+			};
+			physics2d::solveTimeOfImpact(pairs, contacts, contactMargin, sweep, solverBodies, timeOfImpact);
+			for (size_t i = 0; i < boxes.size(); ++i)
+			{
+				boxes[i].velocity = solverBodies[i].velocity;
+				boxes[i].position += solverBodies[i].displacement;
+			}
+
+			for (const auto& contact : contacts)
+			{
+				// Only boxes that push on each other count, so the step of a jump does not give the jump back
+				bool pushes = false;
+				for (uint32_t i = 0; i < contact.pointCount; ++i)
+				{
+					pushes |= contact.points[i].normalImpulse > 0.0f;
+				}
+				if (!pushes)
+				{
+					continue;
+				}
+
+				Box& a = boxes[contact.a];
+				Box& b = boxes[contact.b];
+				a.isColliding = true;
+				b.isColliding = true;
+				if (a.isPlayer && b.isJumpReset)
+				{
+					currentJumps = totalJumps;
+				}
+				else if (b.isPlayer && a.isJumpReset) {
+					currentJumps = totalJumps;
+				}
+			}
+		});
+		const float alpha = fixedStep.getAlpha();
 
 		window.setScreen(-10, 10, -10, 10);
 		window.drawAxis();
@@ -230,9 +301,11 @@ int main() {
 
 		for (const auto& box : boxes)
 		{
-			// getVertices from box and construct mikroplot::vec2 vertices
-			std::vector<mikroplot::vec2> points;
-			for (auto point : getVertices(box, 1.0))
+			// getVertices from box and construct mikroplot::vec2 vertices, drawn between the last two physics states
+			Box drawn = box;
+			drawn.position = physics2d::interpolate(box.oldPosition, box.position, alpha);
+			points.clear();
+			for (auto point : getVertices(drawn, 1.0))
 			{
 				points.push_back({ point.x, point.y });
 			}